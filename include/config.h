@@ -7,6 +7,8 @@
 #include <spdlog/common.h>
 #endif
 
+#include <cstdint>
+#include <limits>
 #include <optional>
 #include <map>
 #include <string>
@@ -26,6 +28,54 @@ namespace OT{
             FILE,
             DIRECTORY,
             RAW_FILE,
+            COMPRESSED_RAW_FILE,
+            STREAM, // raw frames from stdin ("-"), a FIFO or a UNIX socket ("unix:<path>")
+        };
+
+        // Sample format of RAW_FILE inputs. The values are stored in raw containers.
+        enum class PixelFormat : std::uint32_t{
+            S16 = 0, // signed 16-bit
+            U16 = 1, // unsigned 16-bit, worked on as the count minus 32768
+            U14 = 2, // 14-bit in the low bits of 16-bit words
+            U8 = 3,  // unsigned 8-bit
+        };
+
+        // How the files of a DIRECTORY input are checked when it is opened.
+        enum class FrameValidation{
+            FULL,   // decode every image
+            HEADER, // only check that the file signature is a known image format
+            LAZY,   // check nothing, undecodable files are skipped when they are reached
+        };
+
+        enum class BackgroundModelType{
+            MOG2,            // OpenCV's Gaussian mixture model
+            RUNNING_AVERAGE, // running average of the raw samples, much cheaper than MOG2
+            RADIOMETRIC_WINDOW, // no background, pixels in a fixed temperature window are foreground
+        };
+
+        // How blobs are extracted from the foreground mask.
+        enum class DetectionBackend{
+            CONTOURS, // cv::findContours, moments and polygon bounding boxes
+            CCL,      // one connected component labeling pass that yields blob statistics
+        };
+
+        // How the foreground mask is cleaned up before contours are extracted.
+        enum class ForegroundFilterMethod{
+            FUSED,     // threshold, median and dilation in one pass over the mask
+            REFERENCE, // cv::threshold, cv::medianBlur and cv::dilate one after another
+            BITS,      // the same steps on masks with one bit per pixel, 64 pixels at a time
+        };
+
+        // Where the perspective transformation is applied.
+        enum class PerspectiveMode{
+            IMAGE,  // warp every frame and detect on the warped image
+            POINTS, // detect on the original frame and only project the detections
+        };
+
+        // What to do with a DIRECTORY frame identical to one of the frames just before it.
+        enum class DuplicateFrames{
+            KEEP, // track it like any other frame
+            SKIP, // drop it before it reaches the tracker
         };
 
         struct Config{
@@ -42,6 +92,7 @@ namespace OT{
             long lifetimeThreshold = 20;
             float distanceThreshold = 0.1;
             long missedFramesThreshold = 10;
+            // Kalman time step of one frame.
             float dt = 0.2;
             float magnitudeOfAccelerationNoise = 0.5;
             int lifetimeSuppressionThreshold = 20;
@@ -50,6 +101,97 @@ namespace OT{
 
             double foregroundThresh = 130.;
             double foregroundMaxVal = 255.;
+
+            // Geometry and sample format of headerless RAW_FILE and STREAM inputs.
+            // Indexed raw containers carry their own.
+            int sensorWidth = 384;
+            int sensorHeight = 288;
+            PixelFormat pixelFormat = PixelFormat::S16;
+
+            // Scale from radiometric counts to 8-bit intensities for the preview windows.
+            double displayScale = 1. / 16;
+
+            // Map RAW_FILE inputs into memory instead of reading them frame by frame.
+            bool rawMemoryMap = true;
+            // Number of frames the kernel reads ahead of the current one when mapped.
+            std::size_t rawReadAheadFrames = 8;
+
+            // Number of DIRECTORY frames (COMPRESSED_RAW_FILE chunks) decoded ahead of the
+            // tracker, 0 disables read-ahead.
+            std::size_t prefetchDepth = 0;
+            // Number of threads decoding ahead when read-ahead is enabled.
+            std::size_t prefetchThreads = 2;
+            FrameValidation frameValidation = FrameValidation::LAZY;
+
+            // Only frames with a (zero based) index in [startFrame, endFrame) are tracked.
+            // Set endFrame = -1 to track until the end of the input.
+            std::int64_t startFrame = 0;
+            std::int64_t endFrame = -1;
+
+            // Run preprocessing, detection, tracking and output on a thread each, connected
+            // by queues holding up to pipelineQueueDepth frames. Callbacks and preview windows
+            // are then driven from the output and stage threads.
+            bool pipelined = false;
+            std::size_t pipelineQueueDepth = 4;
+
+            // Track in real time at targetFps: wait for each frame's deadline and drop frames
+            // that are already late. The Kalman time step is then dt scaled by the time that
+            // really passed between two tracked frames. Offline, every frame is tracked as
+            // fast as possible with a time step of dt.
+            bool realtime = false;
+            double targetFps = 30.;
+
+            // DIRECTORY frames are compared against the previous duplicateWindow frames.
+            DuplicateFrames duplicateFrames = DuplicateFrames::KEEP;
+            std::size_t duplicateWindow = 1;
+
+            // All three methods give identical masks, REFERENCE is kept to validate the others
+            // against. With the CCL backend, BITS also lets the labeling run on the bit mask
+            // directly, without expanding it to bytes.
+            ForegroundFilterMethod foregroundFilter = ForegroundFilterMethod::FUSED;
+
+            // The background model, the number of frames it remembers and, for
+            // RUNNING_AVERAGE, the difference in sample units that makes a pixel foreground.
+            BackgroundModelType backgroundModel = BackgroundModelType::MOG2;
+            int backgroundHistory = 1000;
+            double backgroundThreshold = 100.;
+
+            // RADIOMETRIC_WINDOW: pixels with windowLow <= temperature <= windowHigh are
+            // foreground, where temperature = radiometricGain * sample + radiometricOffset.
+            // The defaults give the window in working samples, up to the largest one (see
+            // PixelFormat for how the samples of a format map to them). The gain must be
+            // positive. windowLow has no default, what is foreground depends on the scene.
+            double windowLow = std::numeric_limits<double>::quiet_NaN();
+            double windowHigh = 32767.;
+            double radiometricGain = 1.;
+            double radiometricOffset = 0.;
+
+            DetectionBackend detectionBackend = DetectionBackend::CONTOURS;
+
+            // How perspectivePoints is applied. Either way tracks are reported in the
+            // coordinates of the warped and scaled image.
+            PerspectiveMode perspectiveMode = PerspectiveMode::IMAGE;
+
+            // Find blobs on the frame decimated by this factor in each direction and refine
+            // them at full resolution inside their bounding boxes. 2 does most of the work on
+            // a quarter of the pixels, 1 detects at full resolution.
+            int detectionDecimation = 1;
+
+            // Split frames into this many horizontal stripes, each with its own background
+            // model, and run the background subtraction and the foreground filter of the
+            // stripes in parallel. Contours and blobs are still found on the whole mask.
+            int detectionStripes = 1;
+
+            // The background models are restored from this file if it exists, and saved to it
+            // when run() finishes. Empty to start from scratch. The detection parameters of
+            // this config are kept, a snapshot saved with a different detectionDecimation
+            // isn't loaded.
+            // Only RUNNING_AVERAGE and RADIOMETRIC_WINDOW can be saved exactly, MOG2 can't.
+            fs::path backgroundSnapshot;
+
+            // The number of 3x3 dilations that make the foreground blobs larger. Any number
+            // costs the same with the fused filter.
+            int dilateIterations = 4;
         };
 
     } // config
@@ -0,0 +1,114 @@
+
+
+#ifndef OBJECT_TRACKER_COMPRESSED_RAW_H
+#define OBJECT_TRACKER_COMPRESSED_RAW_H
+
+#include "io/pixel_format.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace OT::io {
+    /**
+     * A losslessly compressed raw recording. All integers are stored little endian.
+     *
+     *   CompressedRawHeader
+     *   chunkCount chunks, each holding up to chunkFrames consecutive frames
+     *   std::uint64_t offsets[chunkCount + 1], the file offset of every chunk and of the table
+     *
+     * Every chunk decodes on its own, so chunks can be decoded on several threads and a
+     * seek only has to decode the chunk containing the target frame.
+     *
+     * Inside a chunk the first frame is predicted from the previous sample in raster order
+     * and every following frame from the previous frame, which is almost exact for slowly
+     * changing thermal scenes. Residuals are zigzag encoded and bit-packed in blocks of
+     * compressedBlockSize samples, each block prefixed by a byte holding its bit width.
+     */
+    struct CompressedRawHeader{
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t headerSize;
+        std::uint32_t width;
+        std::uint32_t height;
+        std::uint32_t pixelFormat;  // an OT::config::PixelFormat
+        std::uint32_t chunkFrames;
+        std::uint64_t frameCount;
+        std::uint64_t chunkCount;
+        std::uint64_t indexOffset;
+    };
+    static_assert(sizeof(CompressedRawHeader) == 56, "CompressedRawHeader must not be padded");
+
+    inline constexpr char compressedRawMagic[8] = {'O', 'T', 'R', 'A', 'W', 'Z', 'I', 'P'};
+    inline constexpr std::uint32_t compressedRawVersion = 1;
+    inline constexpr std::size_t compressedBlockSize = 64;
+
+    /**
+     * Validate the header and the chunk table of a compressed recording held in memory.
+     * On success `offsets` points to the (possibly unaligned) chunk table.
+     */
+    bool parseCompressedRaw(const std::uint8_t* data,
+                            std::size_t size,
+                            CompressedRawHeader& header,
+                            const std::uint8_t*& offsets);
+
+    /**
+     * Read the offset of the chunk `index` from a table returned by parseCompressedRaw.
+     * The offset of chunk `chunkCount` is the end of the last chunk.
+     */
+    std::uint64_t compressedChunkOffset(const std::uint8_t* offsets, std::uint64_t index);
+
+    /**
+     * Decode all frames of one chunk into raw sample frames of the header's format.
+     * Returns false if the chunk is corrupt.
+     */
+    bool decodeCompressedChunk(const std::uint8_t* data,
+                               std::size_t size,
+                               const CompressedRawHeader& header,
+                               std::vector<cv::Mat>& frames);
+
+    /**
+     * Compresses frames of a fixed geometry into a chunked recording.
+     */
+    class CompressedRawWriter{
+    public:
+        CompressedRawWriter() = default;
+        CompressedRawWriter(const CompressedRawWriter&) = delete;
+        CompressedRawWriter& operator=(const CompressedRawWriter&) = delete;
+        ~CompressedRawWriter();
+
+        bool open(const std::filesystem::path& path,
+                  std::uint32_t width,
+                  std::uint32_t height,
+                  PixelFormat format,
+                  std::uint32_t chunkFrames = 32);
+
+        // The frame holds raw samples and must match the geometry and format given to open().
+        bool write(const cv::Mat& frame);
+
+        // Flush the last chunk, write the chunk table and the final header.
+        // Called by the destructor if needed.
+        bool close();
+
+        [[nodiscard]] std::uint64_t frameCount() const { return header.frameCount; }
+
+    private:
+        bool flushChunk();
+
+        std::ofstream out;
+        CompressedRawHeader header{};
+        std::vector<std::uint64_t> offsets;
+
+        // The chunk being built, the frames it holds and the samples of its last frame.
+        std::vector<std::uint8_t> chunk;
+        std::uint32_t chunkFrameCount = 0;
+        std::vector<std::uint16_t> previous;
+        std::vector<std::uint16_t> current;
+    };
+}
+
+#endif //OBJECT_TRACKER_COMPRESSED_RAW_H
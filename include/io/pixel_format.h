@@ -0,0 +1,102 @@
+
+
+#ifndef OBJECT_TRACKER_PIXEL_FORMAT_H
+#define OBJECT_TRACKER_PIXEL_FORMAT_H
+
+#include "config.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace OT::io {
+    using OT::config::PixelFormat;
+
+    /**
+     * Everything the tracker does downstream of a raw capture works on CV_16SC1 radiometric
+     * counts. PixelTraits describes how the samples of one sensor format are stored and how a
+     * single sample becomes a working count. Each specialization is branch free, so the
+     * conversion loop below compiles down to a tight (vectorizable) loop per format.
+     */
+    template<PixelFormat Format>
+    struct PixelTraits;
+
+    // Signed 16-bit counts, already the working format.
+    template<>
+    struct PixelTraits<PixelFormat::S16>{
+        using raw_type = std::int16_t;
+        static constexpr int cvType = CV_16SC1;
+        static std::int16_t toWorking(raw_type v){ return v; }
+    };
+
+    // Unsigned 16-bit counts, shifted down by 32768 into the signed range. The shift keeps
+    // every count and their order, so nothing at the hot end is lost, but a working count
+    // of 0 is a raw count of 32768.
+    template<>
+    struct PixelTraits<PixelFormat::U16>{
+        using raw_type = std::uint16_t;
+        static constexpr int cvType = CV_16UC1;
+        static constexpr int workingOffset = 32768;
+        static std::int16_t toWorking(raw_type v){ return (std::int16_t)((std::int32_t)v - workingOffset); }
+    };
+
+    // 14-bit counts in 16-bit words, the upper two bits carry no data.
+    template<>
+    struct PixelTraits<PixelFormat::U14>{
+        using raw_type = std::uint16_t;
+        static constexpr int cvType = CV_16UC1;
+        static std::int16_t toWorking(raw_type v){ return (std::int16_t)(v & 0x3FFF); }
+    };
+
+    // 8-bit counts.
+    template<>
+    struct PixelTraits<PixelFormat::U8>{
+        using raw_type = std::uint8_t;
+        static constexpr int cvType = CV_8UC1;
+        static std::int16_t toWorking(raw_type v){ return (std::int16_t)v; }
+    };
+
+    /**
+     * Convert a frame of raw samples into the working format.
+     * `working` is only reallocated if its size changes.
+     */
+    template<PixelFormat Format>
+    void convertToWorking(const cv::Mat& raw, cv::Mat& working){
+        using Traits = PixelTraits<Format>;
+
+        working.create(raw.rows, raw.cols, CV_16SC1);
+        int cols = raw.cols, rows = raw.rows;
+        if(raw.isContinuous() && working.isContinuous()){
+            cols *= rows;
+            rows = 1;
+        }
+
+        for(int y = 0; y < rows; y++){
+            const auto *src = raw.ptr<typename Traits::raw_type>(y);
+            auto *dst = working.ptr<std::int16_t>(y);
+            for(int x = 0; x < cols; x++){
+                dst[x] = Traits::toWorking(src[x]);
+            }
+        }
+    }
+
+    // The working format needs no conversion, share the data instead.
+    template<>
+    inline void convertToWorking<PixelFormat::S16>(const cv::Mat& raw, cv::Mat& working){
+        working = raw;
+    }
+
+    /**
+     * Pick the conversion for `format`. Dispatch happens once per frame, not per pixel.
+     */
+    void convertToWorking(PixelFormat format, const cv::Mat& raw, cv::Mat& working);
+
+    // OpenCV type of the raw samples of `format`.
+    int rawCvType(PixelFormat format);
+
+    // Size in bytes of one raw sample of `format`.
+    std::size_t bytesPerSample(PixelFormat format);
+}
+
+#endif //OBJECT_TRACKER_PIXEL_FORMAT_H
@@ -0,0 +1,94 @@
+
+
+#ifndef OBJECT_TRACKER_RAW_CONTAINER_H
+#define OBJECT_TRACKER_RAW_CONTAINER_H
+
+#include "io/pixel_format.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace OT::io {
+    /**
+     * An indexed raw recording. All integers are stored little endian.
+     *
+     *   RawContainerHeader
+     *   frame data, frameCount frames of width * height samples of pixelFormat
+     *   std::uint64_t offsets[frameCount], the absolute file offset of every frame
+     *
+     * The offset table is written last, so a recording can be streamed to disk and
+     * still be opened at any frame in O(1).
+     */
+    struct RawContainerHeader{
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t headerSize;
+        std::uint32_t width;
+        std::uint32_t height;
+        std::int32_t cvType;        // OpenCV type of the samples, follows from pixelFormat
+        std::uint32_t pixelFormat;  // an OT::config::PixelFormat
+        std::uint64_t frameCount;
+        std::uint64_t indexOffset;
+    };
+    static_assert(sizeof(RawContainerHeader) == 48, "RawContainerHeader must not be padded");
+
+    inline constexpr char rawContainerMagic[8] = {'O', 'T', 'R', 'A', 'W', 'I', 'D', 'X'};
+    inline constexpr std::uint32_t rawContainerVersion = 1;
+
+    /**
+     * Check whether the buffer starts with a RawContainerHeader.
+     */
+    bool isRawContainer(const std::uint8_t* data, std::size_t size);
+
+    /**
+     * Validate the header and the offset table of a container held in memory.
+     * On success `offsets` points to the (possibly unaligned) offset table.
+     */
+    bool parseRawContainer(const std::uint8_t* data,
+                           std::size_t size,
+                           RawContainerHeader& header,
+                           const std::uint8_t*& offsets);
+
+    /**
+     * Read the offset of the frame `index` from an offset table returned by parseRawContainer.
+     */
+    std::uint64_t rawContainerOffset(const std::uint8_t* offsets, std::uint64_t index);
+
+    /**
+     * Size in bytes of one frame of the container.
+     */
+    std::size_t rawContainerFrameBytes(const RawContainerHeader& header);
+
+    /**
+     * Writes frames of a fixed geometry into an indexed raw container.
+     */
+    class RawContainerWriter{
+    public:
+        RawContainerWriter() = default;
+        RawContainerWriter(const RawContainerWriter&) = delete;
+        RawContainerWriter& operator=(const RawContainerWriter&) = delete;
+        ~RawContainerWriter();
+
+        bool open(const std::filesystem::path& path, std::uint32_t width, std::uint32_t height, PixelFormat format);
+
+        // The frame holds raw samples and must match the geometry and format given to open().
+        bool write(const cv::Mat& frame);
+
+        // Write the offset table and the final header. Called by the destructor if needed.
+        bool close();
+
+        [[nodiscard]] std::uint64_t frameCount() const { return offsets.size(); }
+
+    private:
+        std::ofstream out;
+        RawContainerHeader header{};
+        std::vector<std::uint64_t> offsets;
+    };
+}
+
+#endif //OBJECT_TRACKER_RAW_CONTAINER_H
@@ -0,0 +1,91 @@
+
+
+#ifndef OBJECT_TRACKER_UNION_FIND_H
+#define OBJECT_TRACKER_UNION_FIND_H
+
+#include <limits>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+namespace OT {
+    /**
+     * Disjoint sets over the elements 0 .. size() - 1, stored in flat arrays.
+     *
+     * find() uses path halving and join() attaches the smaller set to the larger one. The
+     * arrays are only ever cleared, so an instance kept between frames stops allocating
+     * once it has seen the largest frame.
+     */
+    template<class Index = int>
+    class UnionFind {
+    public:
+        static constexpr Index none = std::numeric_limits<Index>::max();
+
+        // Start over with n sets of one element each.
+        void reset(Index n) {
+            this->parents.resize(n);
+            std::iota(this->parents.begin(), this->parents.end(), Index(0));
+            this->sizes.assign(n, Index(1));
+        }
+
+        // Add an element in a set of its own and return it.
+        Index add() {
+            const auto element = (Index)this->parents.size();
+            this->parents.push_back(element);
+            this->sizes.push_back(Index(1));
+            return element;
+        }
+
+        [[nodiscard]] Index size() const { return (Index)this->parents.size(); }
+
+        Index find(Index element) {
+            // Path halving: every node visited is pointed at its grandparent.
+            while (this->parents[element] != element) {
+                this->parents[element] = this->parents[this->parents[element]];
+                element = this->parents[element];
+            }
+            return element;
+        }
+
+        // Merge the sets of a and b and return the root of the merged set.
+        Index join(Index a, Index b) {
+            a = this->find(a);
+            b = this->find(b);
+            if (a == b) {
+                return a;
+            }
+            if (this->sizes[a] < this->sizes[b]) {
+                std::swap(a, b);
+            }
+            this->parents[b] = a;
+            this->sizes[a] += this->sizes[b];
+            return a;
+        }
+
+        /**
+         * Number the sets 0 .. count - 1 in the order of their smallest element, set
+         * labels[i] to the number of the set of element i and return the count.
+         */
+        Index labelAll(std::vector<Index>& labels) {
+            const auto n = this->size();
+            labels.assign(n, none);
+            Index count = 0;
+            for (Index element = 0; element < n; element++) {
+                // Only roots are looked up, and a root is labeled when the first element
+                // of its set is reached, which is before or at the root itself.
+                const auto root = this->find(element);
+                if (labels[root] == none) {
+                    labels[root] = count++;
+                }
+                labels[element] = labels[root];
+            }
+            return count;
+        }
+
+    private:
+        std::vector<Index> parents;
+        std::vector<Index> sizes;
+    };
+}
+
+#endif //OBJECT_TRACKER_UNION_FIND_H
@@ -0,0 +1,164 @@
+
+
+#ifndef OBJECT_TRACKER_BACKGROUND_MODEL_H
+#define OBJECT_TRACKER_BACKGROUND_MODEL_H
+
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+#include <opencv2/video/tracking.hpp>
+
+#include "config.h"
+
+namespace OT {
+    /**
+     * Separates moving objects from the static background of a scene.
+     */
+    class BackgroundModel {
+    public:
+        virtual ~BackgroundModel() = default;
+
+        /**
+         * Compute the CV_8UC1 foreground mask of the frame and update the model with it.
+         * Foreground pixels are 255, background pixels 0. Other values are implementation
+         * specific, e.g. shadows.
+         */
+        virtual void apply(const cv::Mat& frame, cv::Mat& mask) = 0;
+
+        /**
+         * Classify the pixels of frame(roi) into a CV_8UC1 mask the size of roi, without
+         * updating the model. The frame may be larger than the ones the model is updated
+         * with, the model is then stretched over it. Returns false if the model can't
+         * classify pixels on their own.
+         */
+        virtual bool classify(const cv::Mat& frame, cv::Rect roi, cv::Mat& mask) { return false; }
+
+        [[nodiscard]] virtual OT::config::BackgroundModelType type() const = 0;
+
+        // A model with the same settings that hasn't learned anything yet.
+        [[nodiscard]] virtual std::unique_ptr<BackgroundModel> createEmpty() const = 0;
+
+        // Whether save() and load() restore exactly what the model has learned.
+        [[nodiscard]] virtual bool savable() const { return true; }
+
+        /**
+         * Write what the model has learned so far, so that a new model of the same type can
+         * continue from it with load(). Returns false on a write error, or if the model
+         * isn't savable().
+         */
+        virtual bool save(std::ostream& out) const = 0;
+        // Returns false if the data is not a saved model of this type.
+        virtual bool load(std::istream& in) = 0;
+    };
+
+    /**
+     * OpenCV's per-pixel Gaussian mixture model.
+     */
+    class Mog2BackgroundModel : public BackgroundModel {
+    public:
+        explicit Mog2BackgroundModel(int history = 1000, int nMixtures = 3);
+
+        void apply(const cv::Mat& frame, cv::Mat& mask) override;
+
+        [[nodiscard]] OT::config::BackgroundModelType type() const override {
+            return OT::config::BackgroundModelType::MOG2;
+        }
+        [[nodiscard]] std::unique_ptr<BackgroundModel> createEmpty() const override;
+
+        // OpenCV doesn't expose the mixtures, and its background image can't stand in for
+        // them, so the model can't be saved.
+        [[nodiscard]] bool savable() const override { return false; }
+        bool save(std::ostream& out) const override { return false; }
+        bool load(std::istream& in) override { return false; }
+
+    private:
+        cv::Ptr<cv::BackgroundSubtractorMOG2> bg;
+    };
+
+    /**
+     * An exponential running average of the frame. A pixel is foreground when it differs
+     * from the average by more than a threshold.
+     *
+     * Works on the single channel 8-bit and 16-bit frames as they are, radiometric counts
+     * are not reduced to 8 bits. Multi-channel frames are converted to gray first.
+     *
+     * The first frames are averaged with equal weights, so the model is usable right away,
+     * afterwards every frame has a weight of 1 / history.
+     */
+    class RunningAverageBackgroundModel : public BackgroundModel {
+    public:
+        /**
+         * history - the number of frames the average effectively spans.
+         * threshold - the smallest difference from the average, in sample units, that
+         *             makes a pixel foreground.
+         */
+        explicit RunningAverageBackgroundModel(int history = 1000, double threshold = 100.);
+
+        void apply(const cv::Mat& frame, cv::Mat& mask) override;
+        bool classify(const cv::Mat& frame, cv::Rect roi, cv::Mat& mask) override;
+
+        [[nodiscard]] OT::config::BackgroundModelType type() const override {
+            return OT::config::BackgroundModelType::RUNNING_AVERAGE;
+        }
+        [[nodiscard]] std::unique_ptr<BackgroundModel> createEmpty() const override;
+        bool save(std::ostream& out) const override;
+        bool load(std::istream& in) override;
+
+    private:
+        template<class Sample>
+        void classifyTyped(const cv::Mat& frame, cv::Size frameSize, cv::Point offset, cv::Mat& mask) const;
+
+        int history;
+        float threshold;
+
+        // The average as CV_32FC1 and the number of frames seen, up to history.
+        cv::Mat background;
+        std::int64_t frames = 0;
+
+        cv::Mat gray;
+        // The frame as CV_32FC1 and its distance from the average.
+        cv::Mat samples;
+        cv::Mat difference;
+    };
+
+    /**
+     * Not a model of the background at all: pixels whose value lies in a fixed window are
+     * foreground. For scenes where the objects are simply the hottest things around, this
+     * needs no warm-up and costs a single comparison per pixel.
+     *
+     * The window is given in temperature units, with temperature = gain * sample + offset.
+     * A gain of 1 and an offset of 0 give the window in raw samples. Multi-channel frames
+     * are converted to gray first.
+     */
+    class RadiometricWindow : public BackgroundModel {
+    public:
+        RadiometricWindow(double low, double high, double gain = 1., double offset = 0.);
+
+        void apply(const cv::Mat& frame, cv::Mat& mask) override;
+        bool classify(const cv::Mat& frame, cv::Rect roi, cv::Mat& mask) override;
+
+        [[nodiscard]] OT::config::BackgroundModelType type() const override {
+            return OT::config::BackgroundModelType::RADIOMETRIC_WINDOW;
+        }
+        [[nodiscard]] std::unique_ptr<BackgroundModel> createEmpty() const override;
+        // There is nothing to learn. The window is saved, but only to warn when a snapshot
+        // was taken with another one, the window of the constructor is kept.
+        bool save(std::ostream& out) const override;
+        bool load(std::istream& in) override;
+
+    private:
+        // The window in samples, inclusive.
+        double low;
+        double high;
+
+        cv::Mat gray;
+    };
+
+    std::unique_ptr<BackgroundModel> createBackgroundModel(const OT::config::Config& config);
+}
+
+#endif //OBJECT_TRACKER_BACKGROUND_MODEL_H
@@ -0,0 +1,39 @@
+
+
+#ifndef OBJECT_TRACKER_BACKGROUND_SNAPSHOT_H
+#define OBJECT_TRACKER_BACKGROUND_SNAPSHOT_H
+
+#include <cstdint>
+
+namespace OT {
+    /**
+     * A snapshot of the detection state, written by ContourFinder::saveSnapshot so that a
+     * new tracker doesn't have to learn the background again. All integers are stored
+     * little endian.
+     *
+     *   BackgroundSnapshotHeader
+     *   std::int32_t suppressRectangles[suppressCount][4], as x, y, width and height, only
+     *                to compare with those of the loading ContourFinder
+     *   the state of each of the `stripes` background models, see BackgroundModel::save
+     */
+    struct BackgroundSnapshotHeader{
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t headerSize;
+        std::uint32_t modelType;        // an OT::config::BackgroundModelType
+        std::uint32_t stripes;
+        std::uint32_t detectionBackend; // an OT::config::DetectionBackend
+        std::int32_t decimation;
+        std::int32_t medianFilterSize;
+        std::int32_t dilateIterations;
+        float contourSizeThreshold;
+        float contourMergeThreshold;
+        std::uint32_t suppressCount;
+    };
+    static_assert(sizeof(BackgroundSnapshotHeader) == 52, "BackgroundSnapshotHeader must not be padded");
+
+    inline constexpr char backgroundSnapshotMagic[8] = {'O', 'T', 'B', 'G', 'S', 'N', 'A', 'P'};
+    inline constexpr std::uint32_t backgroundSnapshotVersion = 2;
+}
+
+#endif //OBJECT_TRACKER_BACKGROUND_SNAPSHOT_H
@@ -0,0 +1,60 @@
+
+
+#ifndef OBJECT_TRACKER_BIT_MASK_H
+#define OBJECT_TRACKER_BIT_MASK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+namespace OT {
+    /**
+     * A binary image with one bit per pixel. Every row starts on a new 64-bit word, pixel x
+     * of a row is bit x % 64 of its word x / 64, and the bits past the last column are
+     * always clear. Eight times less memory to go through than a CV_8UC1 mask, and whole
+     * words of pixels can be combined with one operation.
+     */
+    class BitMask {
+    public:
+        static constexpr int wordBits = 64;
+
+        void create(int rows, int cols);
+
+        [[nodiscard]] bool empty() const { return rows == 0 || cols == 0; }
+
+        std::uint64_t* row(int y) { return &data[(std::size_t)y * words]; }
+        [[nodiscard]] const std::uint64_t* row(int y) const { return &data[(std::size_t)y * words]; }
+
+        [[nodiscard]] bool at(int y, int x) const {
+            return (row(y)[x / wordBits] >> (x % wordBits)) & 1;
+        }
+
+        // Set the pixels of a CV_8UC1 mask that are above thresh, like cv::threshold.
+        void threshold(const cv::Mat& mask, int thresh);
+        void threshold(const cv::Mat& mask, int thresh, int rowBegin, int rowEnd);
+
+        void setZero();
+
+        // Adapter for code that needs a CV_8UC1 mask: set pixels become value, the others 0.
+        void toMat(cv::Mat& mat, std::uint8_t value) const;
+
+        // The first set, or clear, pixel of row y at or after x. cols if there is none.
+        [[nodiscard]] int nextSet(int y, int x) const;
+        [[nodiscard]] int nextClear(int y, int x) const;
+
+        // The mask of the valid bits of the last word of a row.
+        [[nodiscard]] std::uint64_t lastWordMask() const;
+
+        int rows = 0;
+        int cols = 0;
+        // Words per row.
+        int words = 0;
+
+    private:
+        std::vector<std::uint64_t> data;
+    };
+}
+
+#endif //OBJECT_TRACKER_BIT_MASK_H
@@ -0,0 +1,72 @@
+
+
+#ifndef OBJECT_TRACKER_BLOB_LABELING_H
+#define OBJECT_TRACKER_BLOB_LABELING_H
+
+#include <cstdint>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "lib/union_find.h"
+#include "tracker/bit_mask.h"
+#include "tracker/blob_table.h"
+
+namespace OT {
+    /**
+     * Connected component labeling of a binary mask with 8-connectivity.
+     *
+     * Foreground pixels are scanned once, row by row and in runs. Every run takes the label
+     * of the runs it touches in the row above, labels that meet are joined in a union-find,
+     * and the area, coordinate sums and bounds are accumulated per label while scanning.
+     * At the end the statistics of joined labels are combined, so the pixels are never
+     * visited a second time. Only the runs of two rows are kept unless the label image is
+     * asked for. In a bit-packed mask, runs are found a word at a time by counting zeros.
+     */
+    class BlobLabeler {
+    public:
+        /**
+         * Label the non-zero pixels of a CV_8UC1 mask and fill `blobs` with the area, centroid
+         * and bounding box of every blob, without outlines. If `labels` is given it receives
+         * a CV_32SC1 image holding, for every pixel, the row of its blob in `blobs` or -1 for
+         * the background.
+         */
+        void label(const cv::Mat& mask, BlobTable& blobs, cv::Mat* labels = nullptr);
+        void label(const OT::BitMask& mask, BlobTable& blobs, cv::Mat* labels = nullptr);
+
+    private:
+        // A run of foreground pixels [begin, end) and its provisional label.
+        struct Run {
+            int begin;
+            int end;
+            int label;
+        };
+
+        // A provisional label and the statistics of the runs it was given to.
+        struct Partial {
+            std::int64_t area;
+            std::int64_t sumX;
+            std::int64_t sumY;
+            int minX, minY, maxX, maxY;
+        };
+
+        int newLabel();
+
+        void start(int rows, int cols, cv::Mat* labels);
+        // Label the runs of row y, which are in currentRuns, from the runs of the row above.
+        void labelRow(int y, cv::Mat* labels);
+        void finish(BlobTable& blobs, cv::Mat* labels);
+
+        OT::UnionFind<int> sets;
+        std::vector<Partial> partials;
+
+        std::vector<Run> previousRuns;
+        std::vector<Run> currentRuns;
+
+        // Blob index of every provisional label, and the statistics of every blob.
+        std::vector<int> blobOfLabel;
+        std::vector<Partial> totals;
+    };
+}
+
+#endif //OBJECT_TRACKER_BLOB_LABELING_H
@@ -0,0 +1,52 @@
+
+
+#ifndef OBJECT_TRACKER_BLOB_TABLE_H
+#define OBJECT_TRACKER_BLOB_TABLE_H
+
+#include <cstddef>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+namespace OT {
+    /**
+     * The blobs found in a frame, with one column per property and one row per blob.
+     *
+     * The outlines of all blobs share a single arena of points, a row only holds the range
+     * of its outline. Rows are removed by compacting the columns in place, and the table is
+     * cleared rather than freed between frames, so a table that is kept around stops
+     * allocating once it has held the busiest frame.
+     */
+    struct BlobTable {
+        std::vector<cv::Point2f> centers;
+        std::vector<cv::Rect> boxes;
+        std::vector<double> areas;
+
+        // The outline of row i is points[outlineBegin[i], outlineEnd[i]). It is empty when
+        // the outline wasn't traced.
+        std::vector<int> outlineBegin;
+        std::vector<int> outlineEnd;
+        std::vector<cv::Point> points;
+
+        [[nodiscard]] std::size_t size() const { return centers.size(); }
+        [[nodiscard]] bool empty() const { return centers.empty(); }
+        void clear();
+
+        // Append a row with an empty outline at the end of the points.
+        void add(cv::Point2f center, cv::Rect box, double area);
+
+        // Append points to the outline of the last row, which must end at the end of the points.
+        void extendOutline(const std::vector<cv::Point>& outline);
+
+        // The outline of row i as a CV_32SC2 column sharing the points, valid until points are added.
+        [[nodiscard]] cv::Mat outline(std::size_t i);
+        [[nodiscard]] int outlineSize(std::size_t i) const { return outlineEnd[i] - outlineBegin[i]; }
+
+        // Copy row `from` over row `to`. Compacting moves rows to lower indices only.
+        void moveRow(std::size_t from, std::size_t to);
+        // Keep the first n rows. The points of the removed outlines stay until clear().
+        void truncate(std::size_t n);
+    };
+}
+
+#endif //OBJECT_TRACKER_BLOB_TABLE_H
@@ -3,11 +3,20 @@
 #ifndef OBJECT_TRACKER_CONTOUR_FINDER_H
 #define OBJECT_TRACKER_CONTOUR_FINDER_H
 
+#include <filesystem>
+#include <memory>
 #include <vector>
 
 #include <opencv2/opencv.hpp>
 #include <opencv2/video/tracking.hpp>
 
+#include "lib/union_find.h"
+#include "tracker/background_model.h"
+#include "tracker/background_snapshot.h"
+#include "tracker/blob_labeling.h"
+#include "tracker/blob_table.h"
+#include "tracker/foreground_filter.h"
+
 namespace OT {
     /**
      * This class will find blobs representing objects in a frame. It uses
@@ -16,14 +25,73 @@ namespace OT {
      */
     class ContourFinder {
     private:
-        // The background subtractor that isolates the foreground.
-        cv::Ptr<cv::BackgroundSubtractorMOG2> bg;
+        // The background models that isolate the foreground, one per horizontal stripe of
+        // the frame. The stripes are processed in parallel.
+        std::vector<std::unique_ptr<OT::BackgroundModel>> bg;
+
+        // The first row of a stripe of a frame with `rows` rows.
+        int stripeRow(int rows, size_t stripe) const;
+
+        // Run every stripe of the frame through its background model, into mask.
+        void applyBackground(const cv::Mat& frame);
+
+        // BackgroundModel::classify over the stripes of the frame the models were applied to.
+        bool classify(const cv::Mat& frame, cv::Rect roi, cv::Mat& roiMask);
+
+        // The raw foreground mask from the background subtractor.
+        cv::Mat mask;
 
         // The foreground of the frame that should contain the blobs.
         cv::Mat foreground;
 
-        // Remove contours that are too small.
-        void filterOutBadContours(std::vector<std::vector<cv::Point>>& contours) const;
+        // The foreground with one bit per pixel. The CCL backend labels it directly when the
+        // bits filter is used, the byte mask is then only made for display and refinement.
+        OT::BitMask foregroundBits;
+        [[nodiscard]] bool usesBitMask() const;
+
+        // Cleans up the mask into the foreground.
+        OT::ForegroundFilter filter;
+
+        OT::config::DetectionBackend backend = OT::config::DetectionBackend::CONTOURS;
+
+        // Coarse-to-fine detection: blobs are found on the frame decimated by this factor,
+        // then refined at full resolution inside their bounding boxes.
+        int decimation = 1;
+        cv::Mat coarse;
+        // The size of a coarse pixel on the full resolution frame.
+        double coarseScaleX = 1.;
+        double coarseScaleY = 1.;
+        cv::Mat roiMask;
+
+        // Map the blobs found on the coarse frame back onto `frame`.
+        void refine(const cv::Mat& frame, OT::BlobTable& blobs);
+
+        // Whether a mass center of the frame blobs are found on is in a suppressed rectangle.
+        bool isSuppressed(const cv::Point2f& massCenter) const;
+
+        // State of the CCL backend. The label image is only computed when the outlines
+        // of the blobs have to be shown.
+        OT::BlobLabeler labeler;
+        OT::BlobTable labeled;
+        cv::Mat labels;
+
+        // The CCL backend: label the foreground, then filter, suppress and merge the blobs
+        // by their statistics instead of their contours.
+        void findBlobs(OT::BlobTable& blobs);
+
+        // The contour backend. cv::findContours can't write into the blob table, its
+        // contours are copied into the outline points of the blobs that are kept.
+        std::vector<std::vector<cv::Point>> rawContours;
+        std::vector<cv::Vec4i> hierarchy;
+        std::vector<double> contourAreas;
+        std::vector<cv::Point> polygon;
+
+        // Add the contours that are large enough to blobs, with their mass centers and
+        // bounding boxes.
+        void addContours(OT::BlobTable& blobs);
+
+        // Set the mass center and bounding box of a row from its outline.
+        void measureOutline(OT::BlobTable& blobs, std::size_t row);
 
         // Filter out contours whose area is <= contourSizeThreshold * area of largest contour.
         float contourSizeThreshold;
@@ -32,6 +100,15 @@ namespace OT {
         // It must be an odd number.
         int medianFilterSize;
 
+        // The number of 3x3 dilations that make the blobs larger.
+        int dilateIterations = 4;
+
+        // Recreate the filter after its sizes changed, keeping its method and stripes.
+        void rebuildFilter();
+
+        // Write a complete snapshot to path, see saveSnapshot.
+        bool writeSnapshot(const std::filesystem::path& path) const;
+
         // A threshold value between 0 and 1 that indicates when to merge to contours.
         // We merge if the distance between their mass centers is <= diagonal.
         float contourMergeThreshold;
@@ -42,24 +119,40 @@ namespace OT {
         // Ignore mass centers that appear in these rectangles.
         std::vector<cv::Rect> suppressRectangles;
 
-        // Suppress any mass centers that appear in the suppress rectangles.
-        void suppressMassCenters(std::vector<std::vector<cv::Point>>& contours,
-                                 std::vector<cv::Point2f>& massCenters,
-                                 std::vector<cv::Rect>& boundingBoxes);
+        // Remove the blobs whose mass centers appear in the suppress rectangles.
+        void suppressMassCenters(OT::BlobTable& blobs);
 
         /**
-         * Find the mass centers and bounding boxes for the given contours.
+         * Merge nearby contours. A merged blob has the outlines of its contours one after
+         * the other, and the mass center and bounding box of those points.
          */
-        static void getCentersAndBoundingBoxes(const std::vector<std::vector<cv::Point>>& contours,
-                                        std::vector<cv::Point2f>& massCenters,
-                                        std::vector<cv::Rect>& boundingBoxes);
+        void mergeContours(OT::BlobTable& blobs);
 
         /**
-         * Merge nearby contours.
+         * Fill closePairs with the pairs (i, j), i < j, of boxes that are closer than
+         * `distance`, in the order a nested loop over i and j would find them. Only boxes
+         * that overlap horizontally once widened by `distance` are compared.
          */
-        void mergeContours(std::vector<std::vector<cv::Point> > &contours,
-                           const std::vector<cv::Point2f>& massCenters,
-                           const std::vector<cv::Rect>& boundingBoxes) const;
+        void findClosePairs(const std::vector<cv::Rect>& boxes, float distance);
+
+        /**
+         * Group the boxes that are within the merge distance of each other, directly or
+         * through other boxes. Returns the number of groups. Group g holds the boxes
+         * mergeMembers[mergeStart[g]] to mergeMembers[mergeStart[g + 1] - 1] in increasing
+         * order, and the groups are in the order of their first box.
+         */
+        int groupCloseBoxes(const std::vector<cv::Rect>& boxes);
+
+        // Reused between frames.
+        std::vector<int> sweepOrder;
+        std::vector<std::pair<int, int>> closePairs;
+        std::vector<int> kept;
+        std::vector<cv::Rect> keptBoxes;
+        OT::UnionFind<int> mergeSets;
+        std::vector<int> setOfBox;
+        std::vector<int> mergeMembers;
+        std::vector<int> mergeStart;
+        std::vector<std::vector<cv::Point>> blobOutlines;
     public:
         ContourFinder(int history = 1000,
                       int nMixtures = 3,
@@ -68,18 +161,55 @@ namespace OT {
                       float contourMergeThreshold = 0.01);
 
         /**
-         * Find contours representing the objects in the frame.
+         * Find the blobs representing the objects in the frame. `blobs` is cleared first,
+         * keep it between frames to reuse its storage. With the CCL backend the outlines are
+         * only traced when showWindows is set.
          */
         void findContours(const cv::Mat& frame,
-                          std::vector<cv::Vec4i>& hierarchy,
-                          std::vector<std::vector<cv::Point>>& contours,
-                          std::vector<cv::Point2f>& massCenters,
-                          std::vector<cv::Rect>& boundingBoxes,
+                          OT::BlobTable& blobs,
                           double foregroundThresh = 130.,
                           double foregroundMaxVal = 255.);
 
         void suppressRectangle(cv::Rect rect);
 
+        // Replace the background model, MOG2 by default.
+        void setBackgroundModel(std::unique_ptr<OT::BackgroundModel> model);
+
+        // Split frames into as many horizontal stripes as there are models, and run the
+        // background subtraction and the foreground filter of the stripes in parallel.
+        void setBackgroundModels(std::vector<std::unique_ptr<OT::BackgroundModel>> models);
+
+        // Select how the foreground mask is filtered.
+        void setFilterMethod(OT::config::ForegroundFilterMethod method);
+
+        // The number of 3x3 dilations applied to the foreground, 4 by default.
+        void setDilateIterations(int iterations);
+
+        // Select how blobs are extracted from the foreground.
+        void setDetectionBackend(OT::config::DetectionBackend backend);
+
+        // Find blobs on frames decimated by this factor in each direction, 1 turns it off.
+        void setDecimation(int decimation);
+
+        // Whether the background models can be saved, see BackgroundModel::savable.
+        [[nodiscard]] bool canSnapshot() const;
+
+        /**
+         * Save the state of the background models together with the parameters that decide
+         * which blobs are found, see BackgroundSnapshotHeader. The snapshot is written to
+         * path.tmp and renamed to path when complete. Returns false without touching the file
+         * if the models can't be saved or the snapshot can't be written.
+         */
+        bool saveSnapshot(const std::filesystem::path& path) const;
+
+        /**
+         * Continue from a snapshot taken with the same type and number of background models
+         * and the same decimation. The other saved parameters, the suppressed rectangles
+         * included, only give a warning when they differ, the current ones are kept. Returns false if the file can't be read or
+         * doesn't match, and then leaves the models as they were.
+         */
+        bool loadSnapshot(const std::filesystem::path& path);
+
         bool showWindows = false;
     };
 }
@@ -0,0 +1,125 @@
+
+
+#ifndef OBJECT_TRACKER_FOREGROUND_FILTER_H
+#define OBJECT_TRACKER_FOREGROUND_FILTER_H
+
+#include <cstdint>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "config.h"
+#include "tracker/bit_mask.h"
+
+namespace OT {
+    /**
+     * Turns the raw foreground mask of a background subtractor into clean blobs: a binary
+     * threshold, a median blur to remove specks of noise and a dilation to make the blobs
+     * larger.
+     *
+     * After thresholding the mask only holds two values, so the median of a window is set
+     * exactly when more than half of the window is set, and the dilation is set when any of
+     * its window is. The fused method uses this to run all three steps as sliding window
+     * counts in a single pass over the rows, keeping only a few rows of state. The result is
+     * identical to the reference chain of cv::threshold, cv::medianBlur and cv::dilate,
+     * including the borders. Both windows slide by adding the pixels that enter and
+     * subtracting those that leave, so a pixel costs the same for any median size or number
+     * of dilations.
+     *
+     * The bits method does the same on bit-packed masks. The counts of the median window
+     * are kept bit-sliced, bit b of the count of 64 pixels in one word, so that they are
+     * added, shifted and compared a word at a time. The dilation ORs whole words of rows
+     * together, as prefix and suffix ORs over blocks of rows so that a row costs the same
+     * for any number of dilations, and widens them with shifts that double the covered
+     * distance each time.
+     *
+     * The fused and the bits methods can split the mask into horizontal stripes that are
+     * filtered in parallel. Each stripe reads the rows around it that its windows reach into.
+     */
+    class ForegroundFilter {
+    public:
+        /**
+         * medianSize - the size of the median filter, an odd number.
+         * dilateIterations - the number of 3x3 dilations.
+         */
+        explicit ForegroundFilter(int medianSize = 9,
+                                  int dilateIterations = 4,
+                                  OT::config::ForegroundFilterMethod method = OT::config::ForegroundFilterMethod::FUSED);
+
+        /**
+         * Filter a CV_8UC1 mask. Pixels above thresh become maxVal before the median and
+         * the dilation. `filtered` must not be `mask`.
+         */
+        void apply(const cv::Mat& mask, cv::Mat& filtered, double thresh, double maxVal);
+
+        /**
+         * Filter into a bit-packed mask, which is set where the filtered mask is not 0. Only
+         * the bits method avoids the CV_8UC1 mask altogether.
+         */
+        void apply(const cv::Mat& mask, OT::BitMask& filtered, double thresh, double maxVal);
+
+        OT::config::ForegroundFilterMethod method;
+
+        // The number of stripes the fused method filters in parallel.
+        int stripes = 1;
+
+    private:
+        // The state of the fused method while it moves down a stripe.
+        struct Scratch {
+            // Number of set pixels in each column of the current median window.
+            std::vector<std::uint16_t> columnCounts;
+            // columnCounts with replicated borders, the median window slides over it.
+            std::vector<std::uint16_t> paddedCounts;
+            // The median rows of the current dilation window, in a ring.
+            std::vector<std::uint8_t> medianRing;
+            // Number of set median pixels in each column of the current dilation window.
+            std::vector<std::uint16_t> dilateCounts;
+
+            // The bits method: bit-sliced column counts of the median window, the same with
+            // replicated borders, and rows for the dilation.
+            std::vector<std::uint64_t> countSlices;
+            std::vector<std::uint64_t> paddedSlices;
+            std::vector<std::uint64_t> rowBits;
+            std::vector<std::uint64_t> shiftedUp;
+            std::vector<std::uint64_t> shiftedDown;
+            // The suffix ORs of a block of rows, the prefix OR of the next block, and a clear
+            // row for the rows outside the mask.
+            std::vector<std::uint64_t> suffixRows;
+            std::vector<std::uint64_t> prefixRow;
+            std::vector<std::uint64_t> zeroRow;
+        };
+
+        // Call stage(rowBegin, rowEnd, scratch) for every stripe of a mask with `rows` rows.
+        template<class Stage>
+        void forEachStripe(int rows, const Stage& stage);
+
+        // The bits method can't count windows of more than 255 x 255 pixels.
+        [[nodiscard]] bool bitsSupported() const;
+
+        void applyReference(const cv::Mat& mask, cv::Mat& filtered, double thresh, double maxVal) const;
+
+        // Compute the rows [rowBegin, rowEnd) of the filtered mask.
+        void applyFused(const cv::Mat& mask, cv::Mat& filtered, int thresh, std::uint8_t value,
+                        int rowBegin, int rowEnd, Scratch& scratch) const;
+
+        void applyBits(const cv::Mat& mask, OT::BitMask& filtered, int thresh);
+        // Compute the rows [rowBegin, rowEnd) of medianBits from thresholdedBits.
+        void medianBitRows(int rowBegin, int rowEnd, Scratch& scratch);
+        // Compute the rows [rowBegin, rowEnd) of `filtered` by dilating medianBits.
+        void dilateBitRows(OT::BitMask& filtered, int rowBegin, int rowEnd, Scratch& scratch) const;
+
+        int medianSize;
+        int dilateIterations;
+
+        // One per stripe.
+        std::vector<Scratch> stripeScratch;
+
+        // Intermediate masks of the bits method.
+        OT::BitMask thresholdedBits;
+        OT::BitMask medianBits;
+        OT::BitMask packed;
+        cv::Mat bytes;
+    };
+}
+
+#endif //OBJECT_TRACKER_FOREGROUND_FILTER_H
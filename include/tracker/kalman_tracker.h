@@ -43,7 +43,16 @@ namespace OT {
         // The unique color associated with this Kalman tracker.
         cv::Scalar color;
 
+        // The time step the transition and process noise matrices are set up for.
+        float dt;
+
+        // Magnitude of acceleration noise, scales the process noise.
+        float magnitudeOfAccelerationNoise;
+
         void addPointToTrajectory(cv::Point pt);
+
+        // Rebuild the matrices that depend on the time step.
+        void setTimeStep(float dt);
     public:
         KalmanTracker(cv::Point startPt,
                       float dt = 0.2,
@@ -61,7 +70,8 @@ namespace OT {
         // Return the number of frames that this Kalman tracker has been alive.
         long getLifetime();
 
-        cv::Point predict();
+        // Predict the state dt time units after the previous prediction.
+        cv::Point predict(float dt);
         cv::Point latestPrediction();
         cv::Point correct(cv::Point pt);
         OT::TrackingOutput latestTrackingOutput();
@@ -10,6 +10,7 @@
 
 #include <opencv2/opencv.hpp>
 
+#include "tracker/blob_table.h"
 #include "tracker/kalman_tracker.h"
 
 namespace OT {
@@ -34,7 +35,7 @@ namespace OT {
         // without receiving a measurement.
         long missedFramesThreshold;
 
-        // Delta time, used to set up matrices for Kalman trackers.
+        // Delta time of the latest update, used to set up matrices for new Kalman trackers.
         float dt;
 
         // Magnitude of acceleration noise. Used to set up Kalman trackers.
@@ -67,10 +68,11 @@ namespace OT {
                            float distanceSuppressionThreshold = 0.1,
                            float ageSuppressionThreshold = 2);
 
-        // Update the object tracker with the mass centers of the observed boundings rects.
-        void update(const std::vector<cv::Point2f>& massCenters,
-                    const std::vector<cv::Rect>& boundingRects,
-                    std::vector<OT::TrackingOutput>& trackingOutputs);
+        // Update the object tracker with the mass centers and bounding rects of the observed blobs.
+        // dt is the time elapsed since the previous update, in the units of the constructor's dt.
+        void update(const OT::BlobTable& blobs,
+                    std::vector<OT::TrackingOutput>& trackingOutputs,
+                    float dt);
     };
 }
 
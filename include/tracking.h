@@ -6,17 +6,31 @@
 #include "config.h"
 #include "tracker/tracker_log.h"
 #include "tracker/multi_object_tracker.h"
+#include "tracker/blob_table.h"
 #include "tracker/contour_finder.h"
 #include "utils/misc.h"
 #include "utils/draw.h"
 #include "utils/perspective_transformer.h"
+#include "utils/warp_scale_map.h"
+#include "utils/mapped_file.h"
+#include "utils/stream_reader.h"
+#include "utils/ordered_prefetcher.h"
+#include "utils/spsc_queue.h"
+#include "utils/frame_hash.h"
+#include "io/raw_container.h"
+#include "io/pixel_format.h"
+#include "io/compressed_raw.h"
 
 #include "opencv2/opencv.hpp"
 
 #include <filesystem>
 #include <vector>
 #include <set>
+#include <unordered_map>
 #include <fstream>
+#include <cstdio>
+#include <algorithm>
+#include <chrono>
 
 namespace fs = std::filesystem;
 
@@ -48,25 +62,108 @@ namespace OT::tracking{
 
     class FramesDirCapture: public CustomVideoCapture{
     public:
+        /**
+         * prefetchDepth - number of frames decoded ahead of the tracker on a pool of
+         *                 prefetchThreads workers. With 0 every frame is decoded in grab().
+         * validation - how thoroughly files are checked when the directory is opened.
+         *              Files that turn out to be invalid later are skipped when reached.
+         * duplicates, duplicateWindow - what to do with a frame whose content hash matches one
+         *                               of the previous duplicateWindow frames.
+         */
+        explicit FramesDirCapture(std::size_t prefetchDepth = 0,
+                                  std::size_t prefetchThreads = 1,
+                                  OT::config::FrameValidation validation = OT::config::FrameValidation::LAZY,
+                                  OT::config::DuplicateFrames duplicates = OT::config::DuplicateFrames::KEEP,
+                                  std::size_t duplicateWindow = 1)
+            : prefetchDepth(prefetchDepth), prefetchThreads(prefetchThreads), validation(validation),
+              duplicates(duplicates), recentHashes(std::max<std::size_t>(duplicateWindow, 1)) {}
 
         bool open(const cv::String& dirname, int apiPreference, const std::vector<int> &params) override;
 
         FramesDirCapture &operator>>(cv::Mat &image) override;
 
         [[nodiscard]] bool isOpened() const override {
-            return !filenames.empty() && cur_iter != filenames.end();
+            return !filenames.empty() && (already_grabbed || cur_index < filenames.size());
         }
 
         bool grab() override;
 
+        /**
+         * Supports CAP_PROP_POS_FRAMES, the position is an index into the sorted files.
+         */
+        bool set(int propId, double value) override;
+
+        /**
+         * Supports CAP_PROP_POS_FRAMES and CAP_PROP_FRAME_COUNT.
+         */
+        [[nodiscard]] double get(int propId) const override;
+
     private:
+        // An image with the hash of its pixels, computed where it is decoded.
+        struct DecodedFrame{
+            cv::Mat image;
+            std::uint64_t hash = 0;
+        };
+
+        static DecodedFrame decode(const fs::path& filename);
+
+        // (Re)start the read-ahead workers at cur_index.
+        void startPrefetch();
+
+        // Whether the hash matches one of the recent frames. The hash becomes the most recent one.
+        bool seenRecently(std::uint64_t hash);
+        void forgetRecentHashes();
+
+        // Set by grab() until operator>> hands the frame out. Like cv::VideoCapture::grab,
+        // every call to grab() moves on to the next frame, which is how frames are dropped.
+        bool already_grabbed = false;
+
+        std::size_t prefetchDepth;
+        std::size_t prefetchThreads;
+
+        OT::config::FrameValidation validation;
+        OT::config::DuplicateFrames duplicates;
+
+        // Hashes of the last frames in a ring, with the number of times each one occurs in it.
+        std::vector<std::uint64_t> recentHashes;
+        std::size_t recentCount = 0;
+        std::size_t recentNext = 0;
+        std::unordered_map<std::uint64_t, std::size_t> recentOccurrences;
+
         cv::Mat cur_image;
-        std::map<std::uint64_t, fs::path> filenames;
-        std::map<std::uint64_t, fs::path>::iterator cur_iter = filenames.begin();
+
+        // Frame files sorted by the number in their name.
+        std::vector<std::pair<std::uint64_t, fs::path>> filenames;
+        std::size_t cur_index = 0;
+
+        // Declared last, so the workers are stopped before what they read is destroyed.
+        std::unique_ptr<OT::utils::OrderedPrefetcher<DecodedFrame>> prefetcher = nullptr;
     };
 
     class RawFileCapture: public CustomVideoCapture{
     public:
+        /**
+         * memoryMap - map the file and hand out frames that point straight into the mapping
+         *             instead of reading every frame into a buffer.
+         * readAheadFrames - how many frames ahead of the current one the kernel is asked to
+         *                   read. Pages behind the current frame are dropped, so the resident
+         *                   part of the file stays bounded whatever its length.
+         * frameSize, format - geometry and sample format of headerless recordings. Indexed
+         *                     containers carry their own.
+         * copyFrames - copy frames that would point into the mapping into buffers of our own.
+         *              Needed when a frame is still used after the next grab, as in pipelined
+         *              mode, since grabbing drops the pages behind the new frame.
+         *
+         * Frames are always handed out as CV_16SC1 counts.
+         */
+        explicit RawFileCapture(bool memoryMap = true,
+                                std::size_t readAheadFrames = 8,
+                                cv::Size frameSize = cv::Size(384, 288),
+                                OT::config::PixelFormat format = OT::config::PixelFormat::S16,
+                                bool copyFrames = false)
+            : memoryMap(memoryMap), readAheadFrames(readAheadFrames), sensorSize(frameSize), sensorFormat(format),
+              copyFrames(copyFrames) {}
+
         bool open(const cv::String &filename){
             return RawFileCapture::open(filename, cv::CAP_ANY);
         }
@@ -80,18 +177,213 @@ namespace OT::tracking{
         RawFileCapture &operator>>(cv::Mat &image) override;
 
         [[nodiscard]] bool isOpened() const override {
-            return m_file != nullptr;
+            return m_mapped.isOpen() || m_file != nullptr;
         }
 
         bool grab() override;
 
-        static const uint32_t X_img = 288, Y_img = 384;
+        /**
+         * Supports CAP_PROP_POS_FRAMES, which jumps to any frame in O(1).
+         */
+        bool set(int propId, double value) override;
+
+        /**
+         * Supports CAP_PROP_POS_FRAMES, CAP_PROP_FRAME_COUNT, CAP_PROP_FRAME_WIDTH
+         * and CAP_PROP_FRAME_HEIGHT.
+         */
+        [[nodiscard]] double get(int propId) const override;
+
     private:
+        bool openBuffered(const fs::path &path);
+
+        // File offset of the frame with the given index.
+        [[nodiscard]] std::uint64_t frameOffset(std::uint64_t index) const;
+
         bool already_grabbed = false;
 
+        bool memoryMap;
+        std::size_t readAheadFrames;
+
+        cv::Size sensorSize;
+        OT::config::PixelFormat sensorFormat;
+        bool copyFrames;
+
+        // Raw samples of the current frame and the frame converted to counts. The two share
+        // their data when the samples already are counts.
+        cv::Mat m_raw;
         cv::Mat cur_image;
-        std::unique_ptr<std::FILE> m_file;
-        std::uint64_t filepos = 0;
+
+        // With copyFrames, the buffers frames are copied into. A buffer is reused once
+        // nobody else holds it any more, so the pool grows to the number of frames in flight.
+        std::vector<cv::Mat> m_pool;
+        cv::Mat &freeBuffer();
+
+        // Geometry and format of the opened file.
+        int m_rows = 0;
+        int m_cols = 0;
+        OT::config::PixelFormat m_format = OT::config::PixelFormat::S16;
+        std::size_t m_frameBytes = 0;
+
+        // Index of the next frame to grab and the number of frames in the file.
+        std::uint64_t m_pos = 0;
+        std::uint64_t m_frameCount = 0;
+
+        // Offset table of an indexed container, either inside the mapping or read into memory.
+        // Both are empty for headerless recordings, whose frames are simply back to back.
+        const std::uint8_t *m_index = nullptr;
+        std::vector<std::uint64_t> m_offsets;
+
+        // Used when the file is mapped: the offset up to which pages have been released.
+        OT::utils::MappedFile m_mapped;
+        std::size_t m_released = 0;
+
+        // Used otherwise, frames are read into the single buffer of cur_image.
+        std::unique_ptr<std::FILE, decltype(&std::fclose)> m_file{nullptr, &std::fclose};
+        std::uint64_t m_fileOffset = 0;
+    };
+
+    /**
+     * Reads losslessly compressed recordings written by OT::io::CompressedRawWriter.
+     * Chunks are decoded on a pool of workers ahead of the tracker.
+     */
+    class CompressedRawCapture: public CustomVideoCapture{
+    public:
+        /**
+         * prefetchChunks - number of chunks decoded ahead of the tracker on a pool of
+         *                  decodeThreads workers. With 0 every chunk is decoded in grab().
+         */
+        explicit CompressedRawCapture(std::size_t prefetchChunks = 2, std::size_t decodeThreads = 2)
+            : prefetchChunks(prefetchChunks), decodeThreads(decodeThreads) {}
+
+        bool open(const cv::String &filename){
+            return CompressedRawCapture::open(filename, cv::CAP_ANY);
+        }
+
+        bool open(const cv::String &filename, int apiPreference) override {
+            return CompressedRawCapture::open(filename, apiPreference, {});
+        }
+
+        bool open(const cv::String& filename, int apiPreference, const std::vector<int> &params) override;
+
+        CompressedRawCapture &operator>>(cv::Mat &image) override;
+
+        [[nodiscard]] bool isOpened() const override {
+            return m_mapped.isOpen();
+        }
+
+        bool grab() override;
+
+        /**
+         * Supports CAP_PROP_POS_FRAMES. Only the chunk holding the target frame is decoded.
+         */
+        bool set(int propId, double value) override;
+
+        /**
+         * Supports CAP_PROP_POS_FRAMES, CAP_PROP_FRAME_COUNT, CAP_PROP_FRAME_WIDTH
+         * and CAP_PROP_FRAME_HEIGHT.
+         */
+        [[nodiscard]] double get(int propId) const override;
+
+    private:
+        // Decode a chunk and convert its frames to counts. Called from the workers.
+        std::vector<cv::Mat> loadChunk(std::size_t index) const;
+
+        // Make the chunk holding m_pos current, (re)starting the workers if needed.
+        bool seekChunk();
+
+        bool already_grabbed = false;
+
+        std::size_t prefetchChunks;
+        std::size_t decodeThreads;
+
+        cv::Mat cur_image;
+
+        OT::utils::MappedFile m_mapped;
+        OT::io::CompressedRawHeader m_header{};
+        const std::uint8_t *m_offsets = nullptr;
+
+        // Index of the next frame to grab, and the decoded frames of the current chunk.
+        std::uint64_t m_pos = 0;
+        std::vector<cv::Mat> m_chunk;
+        std::uint64_t m_chunkIndex = 0;
+        bool m_chunkLoaded = false;
+
+        // Declared last, so the workers are stopped before the mapping goes away.
+        std::unique_ptr<OT::utils::OrderedPrefetcher<std::vector<cv::Mat>>> prefetcher = nullptr;
+    };
+
+    /**
+     * Reads back to back raw frames of a fixed geometry from a live byte stream, see
+     * OT::utils::StreamReader for the supported sources. A frame is only read when the
+     * tracker asks for one, so a producer that is too fast is throttled by the pipe.
+     */
+    class StreamCapture: public CustomVideoCapture{
+    public:
+        /**
+         * buffers - number of frame buffers cycled through. Buffers are reused as long as
+         *           the frame read into them has been released.
+         */
+        explicit StreamCapture(cv::Size frameSize = cv::Size(384, 288),
+                               OT::config::PixelFormat format = OT::config::PixelFormat::S16,
+                               std::size_t buffers = 4)
+            : frameSize(frameSize), format(format), m_buffers(std::max<std::size_t>(buffers, 1)) {}
+
+        bool open(const cv::String &source){
+            return StreamCapture::open(source, cv::CAP_ANY);
+        }
+
+        bool open(const cv::String &source, int apiPreference) override {
+            return StreamCapture::open(source, apiPreference, {});
+        }
+
+        bool open(const cv::String& source, int apiPreference, const std::vector<int> &params) override;
+
+        StreamCapture &operator>>(cv::Mat &image) override;
+
+        [[nodiscard]] bool isOpened() const override {
+            return m_reader.isOpen();
+        }
+
+        bool grab() override;
+
+        /**
+         * Supports CAP_PROP_POS_FRAMES, CAP_PROP_FRAME_WIDTH and CAP_PROP_FRAME_HEIGHT.
+         */
+        [[nodiscard]] double get(int propId) const override;
+
+    private:
+        bool already_grabbed = false;
+
+        cv::Size frameSize;
+        OT::config::PixelFormat format;
+
+        OT::utils::StreamReader m_reader;
+        std::vector<cv::Mat> m_buffers;
+        std::uint64_t m_frames = 0;
+
+        cv::Mat cur_image;
+    };
+
+    /**
+     * Everything the tracker knows about one frame. In pipelined mode a packet travels
+     * through the stages and each stage fills in its part.
+     */
+    struct FramePacket{
+        std::uint64_t frameNumber = 0;
+        cv::Mat frame;
+
+        // Time since the previous tracked frame, in the units of Config::dt.
+        float dt = 0;
+
+        // Filled by the detection stage.
+        OT::BlobTable blobs;
+
+        // In the POINTS perspective mode, maps the preprocessed frame to the warped and
+        // scaled plane the detections are projected to.
+        cv::Mat homography;
+
+        // Filled by the tracking stage.
+        std::vector<OT::TrackingOutput> predictions;
     };
 
     class Tracker{
@@ -99,6 +391,11 @@ namespace OT::tracking{
         explicit Tracker(const OT::config::Config& config);
         void run();
         std::string track_frame(const cv::Mat& frame);
+
+        // Save or restore the learned background, see ContourFinder::saveSnapshot.
+        bool save_background(const std::filesystem::path& path) const;
+        bool load_background(const std::filesystem::path& path);
+        // Show the preview windows. Has no effect in headless builds (OT_HEADLESS).
         bool show_windows = true;
 
         void add_tracking_callback(const tracking_callback& );
@@ -106,34 +403,60 @@ namespace OT::tracking{
         void add_end_tracking_callback(const end_tracking_callback& );
 
     private:
+        // The stages a frame goes through, in order. Every stage only touches its own
+        // members, so in pipelined mode each one can run on its own thread.
+        void preprocess(FramePacket& packet);
+        void detect(FramePacket& packet);
+        void associate(FramePacket& packet);
+        void emit(FramePacket& packet);
+
+        // POINTS perspective mode: move the detections of a packet onto the warped plane.
+        static void projectDetections(FramePacket& packet);
+        // The size of the image the detections of a packet are in.
+        [[nodiscard]] cv::Size trackingSize(const FramePacket& packet) const;
+
+        // Run the stages on one thread per stage, capture stays on the calling thread.
+        void runPipelined();
+
+        // Capture the next frame to track. In real time mode this waits for the frame's
+        // deadline, or drops frames that are already late.
+        bool nextFrame(FramePacket& packet);
+
+        void logThroughput(std::uint64_t frames, std::chrono::duration<double> elapsed) const;
+
         // This does the actual tracking of the objects. We can't initialize it now because
         // it needs to know the size of the frame. So, we set it equal to nullptr and initialize
         // it after we get the first frame.
         std::unique_ptr<OT::MultiObjectTracker> tracker = nullptr;
 
-        // We'll use this variable to store the current frame captured from the video.
-        cv::Mat m_frame;
-
         // This object represents the video or image sequence that we are reading from.
         std::unique_ptr<cv::VideoCapture> capture = nullptr;
 
-        // These two variables store the contours and contour hierarchy for the current frame.
-        // We won't use the hierarchy, but we need it in order to be able to call the cv::findContours
-        // function.
-        std::vector<cv::Vec4i> hierarchy;
-        std::vector<std::vector<cv::Point> > contours;
-
         // We'll use a ContourFinder to do the actual extraction of contours from the image.
         OT::ContourFinder contourFinder;
 
         OT::TrackerLog trackerLog{true};
         cv::Mat perspectiveMatrix;
         cv::Size perspectiveSize;
+        // The perspective transform and the scaling, applied in one pass.
+        OT::perspective::WarpScaleMap warpScale;
+        // The POINTS perspective mode: the size of the plane tracks are reported in, and the
+        // homography to it from frames of pointSourceSize.
+        bool pointSpace = false;
+        cv::Size planeSize;
+        cv::Size pointSourceSize;
+        cv::Mat pointHomography;
         std::vector<cv::Point2f> points;
 
         std::uint64_t frameNumber = 0;
         std::int64_t maxDimension;
 
+        // Real time pacing: frame paceFirstFrame was captured at paceStart.
+        bool paceStarted = false;
+        std::chrono::steady_clock::time_point paceStart, lastFrameTime;
+        std::uint64_t paceFirstFrame = 0;
+        std::uint64_t droppedFrames = 0;
+
         std::unique_ptr<cv::VideoWriter> vw_orig = nullptr, vw_video = nullptr;
 
         OT::config::Config config;
@@ -0,0 +1,41 @@
+
+
+#ifndef OBJECT_TRACKER_BINARY_IO_H
+#define OBJECT_TRACKER_BINARY_IO_H
+
+#include <opencv2/opencv.hpp>
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <type_traits>
+
+namespace OT::utils {
+    /**
+     * Write a trivially copyable value as its bytes, which are little endian on every
+     * platform we run on.
+     */
+    template<class T>
+    bool writeValue(std::ostream& out, const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+        return (bool)out;
+    }
+
+    template<class T>
+    bool readValue(std::istream& in, T& value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        in.read(reinterpret_cast<char*>(&value), sizeof(T));
+        return (bool)in;
+    }
+
+    /**
+     * Write a matrix as its type, rows and columns followed by the pixels, row by row.
+     */
+    bool writeMat(std::ostream& out, const cv::Mat& mat);
+
+    // Returns false if the stream ends early or doesn't hold a matrix.
+    bool readMat(std::istream& in, cv::Mat& mat);
+}
+
+#endif //OBJECT_TRACKER_BINARY_IO_H
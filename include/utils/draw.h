@@ -6,6 +6,8 @@
 
 #include <opencv2/opencv.hpp>
 
+#include "tracker/blob_table.h"
+
 namespace OT::utils::draw {
         /**
          * Draw a cross on the image.
@@ -28,11 +30,11 @@ namespace OT::utils::draw {
                             const cv::Scalar& color);
 
         /**
-         * Draw the contours in a new image and show them.
+         * Draw the outlines and bounding boxes of the blobs in a new image and show them.
+         * Does nothing in headless builds.
          */
         void contourShow(const std::string& drawingName,
-                         const std::vector<std::vector<cv::Point>>& contours,
-                         const std::vector<cv::Rect>& boundingRect,
+                         const OT::BlobTable& blobs,
                          cv::Size imgSize);
     }
 
@@ -0,0 +1,22 @@
+
+
+#ifndef OBJECT_TRACKER_FRAME_HASH_H
+#define OBJECT_TRACKER_FRAME_HASH_H
+
+#include <opencv2/opencv.hpp>
+
+#include <cstdint>
+
+namespace OT::utils {
+    /**
+     * A 64-bit fingerprint of the frame's size, type and pixels, used to spot repeated frames
+     * without comparing them element by element. Different frames get the same hash with a
+     * probability of about 2^-64.
+     *
+     * The data is mixed in four independent lanes of 64-bit words, which keeps the
+     * multipliers busy and lets the compiler vectorize the loop.
+     */
+    std::uint64_t frameHash(const cv::Mat& frame);
+}
+
+#endif //OBJECT_TRACKER_FRAME_HASH_H
@@ -0,0 +1,46 @@
+
+
+#ifndef OBJECT_TRACKER_MAPPED_FILE_H
+#define OBJECT_TRACKER_MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+namespace OT::utils {
+    /**
+     * A whole file mapped into memory. The mapping is private (copy-on-write), so
+     * frames handed out from it may be drawn on without touching the file.
+     *
+     * Only available on POSIX systems; elsewhere open() always fails and callers
+     * are expected to fall back to regular reads.
+     */
+    class MappedFile {
+    public:
+        MappedFile() = default;
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        ~MappedFile();
+
+        // Map the whole file. Empty files can't be mapped and are reported as failure.
+        bool open(const std::filesystem::path& path);
+        void close();
+
+        [[nodiscard]] bool isOpen() const { return m_data != nullptr; }
+        [[nodiscard]] std::size_t size() const { return m_size; }
+        [[nodiscard]] std::uint8_t* data() const { return m_data; }
+
+        // Ask the kernel to start reading [offset, offset + length) in the background.
+        void willNeed(std::size_t offset, std::size_t length) const;
+
+        // Drop the pages that lie entirely inside [offset, offset + length) from the
+        // working set. Private copies made by writing to them are discarded as well.
+        void dontNeed(std::size_t offset, std::size_t length) const;
+
+    private:
+        std::uint8_t* m_data = nullptr;
+        std::size_t m_size = 0;
+    };
+}
+
+#endif //OBJECT_TRACKER_MAPPED_FILE_H
@@ -16,6 +16,16 @@ bool hasFrame(cv::VideoCapture& capture);
  * Set maxDimension = -1 if you don't want to do any scaling.
  */
 void scale(cv::Mat& img, std::int64_t maxDimension);
+/**
+ * The size scale() resizes an image of the given size to.
+ */
+cv::Size scaledSize(cv::Size size, std::int64_t maxDimension);
+/**
+ * Prepare a buffer that is about to be refilled. If a frame handed out earlier still
+ * shares its data, the buffer is detached so that the next create() allocates a new
+ * one instead of overwriting a frame that is in use. Otherwise the data is reused.
+ */
+void detachIfShared(cv::Mat& buffer);
 }
 
 
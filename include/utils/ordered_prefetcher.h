@@ -0,0 +1,125 @@
+
+
+#ifndef OBJECT_TRACKER_ORDERED_PREFETCHER_H
+#define OBJECT_TRACKER_ORDERED_PREFETCHER_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace OT::utils {
+    /**
+     * Loads the items [first, count) on a pool of worker threads and hands them out strictly in
+     * index order. At most `depth` items are loaded ahead of the consumer, so memory stays
+     * bounded, and workers block once the ring is full.
+     *
+     * The loader is called concurrently from several threads and must be thread safe.
+     */
+    template<class T>
+    class OrderedPrefetcher {
+    public:
+        using Loader = std::function<T(std::size_t index)>;
+
+        OrderedPrefetcher(std::size_t count,
+                          Loader loader,
+                          std::size_t depth,
+                          std::size_t threads,
+                          std::size_t first = 0)
+                : loader(std::move(loader)), slots(std::max<std::size_t>(depth, 1)), count(count),
+                  nextToLoad(first), nextToPop(first) {
+            for (std::size_t i = 0; i < std::max<std::size_t>(threads, 1); i++) {
+                workers.emplace_back(&OrderedPrefetcher::work, this);
+            }
+        }
+
+        OrderedPrefetcher(const OrderedPrefetcher&) = delete;
+        OrderedPrefetcher& operator=(const OrderedPrefetcher&) = delete;
+
+        ~OrderedPrefetcher() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            slotFreed.notify_all();
+            for (auto &worker: workers) {
+                worker.join();
+            }
+        }
+
+        /**
+         * Wait for the next item in order and move it into `item`.
+         * Returns false once all items have been handed out.
+         */
+        bool pop(T &item) {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (nextToPop >= count) {
+                return false;
+            }
+
+            auto &slot = slots[nextToPop % slots.size()];
+            slotFilled.wait(lock, [&slot] { return slot.ready; });
+
+            item = std::move(slot.value);
+            slot.value = T{};
+            slot.ready = false;
+            nextToPop++;
+
+            lock.unlock();
+            slotFreed.notify_all();
+            return true;
+        }
+
+    private:
+        struct Slot {
+            bool ready = false;
+            T value{};
+        };
+
+        void work() {
+            for (;;) {
+                std::size_t index;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    // The slot of `nextToLoad` is free once the item `depth` places before it was popped.
+                    slotFreed.wait(lock, [this] {
+                        return stopping || nextToLoad >= count || nextToLoad < nextToPop + slots.size();
+                    });
+                    if (stopping || nextToLoad >= count) {
+                        return;
+                    }
+                    index = nextToLoad++;
+                }
+
+                T value = loader(index);
+
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    auto &slot = slots[index % slots.size()];
+                    slot.value = std::move(value);
+                    slot.ready = true;
+                }
+                slotFilled.notify_all();
+            }
+        }
+
+        Loader loader;
+
+        std::vector<Slot> slots;
+        std::size_t count;
+        std::size_t nextToLoad;
+        std::size_t nextToPop;
+        bool stopping = false;
+
+        std::mutex mutex;
+        std::condition_variable slotFreed;
+        std::condition_variable slotFilled;
+        std::vector<std::thread> workers;
+    };
+}
+
+#endif //OBJECT_TRACKER_ORDERED_PREFETCHER_H
@@ -0,0 +1,108 @@
+
+
+#ifndef OBJECT_TRACKER_SPSC_QUEUE_H
+#define OBJECT_TRACKER_SPSC_QUEUE_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace OT::utils {
+    /**
+     * A bounded lock-free queue between exactly one producer thread and one consumer thread.
+     * Items come out in the order they were pushed.
+     *
+     * push() waits while the queue is full, which throttles a fast producer to the pace of
+     * its consumer. Once the producer calls close(), pop() drains the remaining items and
+     * then returns false. Waiting threads yield first and back off to short sleeps, so an
+     * idle stage doesn't keep a core busy.
+     *
+     * Items are swapped in and out of the slots rather than moved, so each side gets back an
+     * item the other side is done with. Items that own buffers keep circulating with them
+     * instead of being reallocated for every push.
+     */
+    template<class T>
+    class SpscQueue {
+    public:
+        // One slot stays empty to tell a full ring from an empty one.
+        explicit SpscQueue(std::size_t capacity) : slots(std::max<std::size_t>(capacity, 1) + 1) {}
+
+        SpscQueue(const SpscQueue&) = delete;
+        SpscQueue& operator=(const SpscQueue&) = delete;
+
+        // Producer side. If it was queued, `item` receives an item that was popped earlier,
+        // or a default constructed one.
+        bool tryPush(T &item) {
+            const auto tail = m_tail.load(std::memory_order_relaxed);
+            const auto next = advance(tail);
+            if (next == m_head.load(std::memory_order_acquire)) {
+                return false;
+            }
+            using std::swap;
+            swap(slots[tail], item);
+            m_tail.store(next, std::memory_order_release);
+            return true;
+        }
+
+        void push(T &item) {
+            for (unsigned attempts = 0; !tryPush(item); attempts++) {
+                backoff(attempts);
+            }
+        }
+
+        // No more items will be pushed.
+        void close() {
+            m_closed.store(true, std::memory_order_release);
+        }
+
+        // Consumer side.
+        bool tryPop(T &item) {
+            const auto head = m_head.load(std::memory_order_relaxed);
+            if (head == m_tail.load(std::memory_order_acquire)) {
+                return false;
+            }
+            using std::swap;
+            swap(item, slots[head]);
+            m_head.store(advance(head), std::memory_order_release);
+            return true;
+        }
+
+        // Wait for the next item. Returns false once the queue is closed and drained.
+        bool pop(T &item) {
+            for (unsigned attempts = 0; !tryPop(item); attempts++) {
+                // Anything pushed before close() is visible once the flag is, so look once more.
+                if (m_closed.load(std::memory_order_acquire)) {
+                    return tryPop(item);
+                }
+                backoff(attempts);
+            }
+            return true;
+        }
+
+    private:
+        static void backoff(unsigned attempts) {
+            if (attempts < 64) {
+                std::this_thread::yield();
+            } else {
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+        }
+
+        std::size_t advance(std::size_t index) const {
+            return index + 1 == slots.size() ? 0 : index + 1;
+        }
+
+        std::vector<T> slots;
+
+        // Written by different threads, kept on separate cache lines.
+        alignas(64) std::atomic<std::size_t> m_head{0};
+        alignas(64) std::atomic<std::size_t> m_tail{0};
+        std::atomic<bool> m_closed{false};
+    };
+}
+
+#endif //OBJECT_TRACKER_SPSC_QUEUE_H
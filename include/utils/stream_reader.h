@@ -0,0 +1,44 @@
+
+
+#ifndef OBJECT_TRACKER_STREAM_READER_H
+#define OBJECT_TRACKER_STREAM_READER_H
+
+#include <cstddef>
+#include <string>
+
+namespace OT::utils {
+    /**
+     * Blocking reads from a byte stream: standard input, a FIFO or a local UNIX socket.
+     *
+     * Nothing is buffered on our side, data is only read when the caller asks for it. A
+     * producer writing faster than we consume therefore blocks once the pipe or socket
+     * buffer is full, which is the backpressure live sources need.
+     *
+     * Only available on POSIX systems; elsewhere open() always fails.
+     */
+    class StreamReader {
+    public:
+        StreamReader() = default;
+        StreamReader(const StreamReader&) = delete;
+        StreamReader& operator=(const StreamReader&) = delete;
+        ~StreamReader();
+
+        /**
+         * "-" reads standard input, "unix:<path>" connects to a UNIX stream socket and
+         * anything else is opened as a file, usually a FIFO.
+         */
+        bool open(const std::string& source);
+        void close();
+
+        [[nodiscard]] bool isOpen() const { return m_fd >= 0; }
+
+        // Read exactly `size` bytes. Returns false at end of stream or on error.
+        bool readFully(void* buffer, std::size_t size);
+
+    private:
+        int m_fd = -1;
+        bool m_owned = false;
+    };
+}
+
+#endif //OBJECT_TRACKER_STREAM_READER_H
@@ -14,9 +14,12 @@
 #include "lyra/opt.hpp"
 
 #include <algorithm>
+#include <cmath>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <limits>
+#include <map>
 #include <string>
 #include <string_view>
 
@@ -24,12 +27,65 @@ namespace fs = std::filesystem;
 
 OT::config::TrackingMode ToMode(const std::string &mode) {
   OT::config::TrackingMode m =
-      mode == "dir" ? OT::config::TrackingMode::DIRECTORY
-                    : (mode == "file" ? OT::config::TrackingMode::FILE
-                                      : OT::config::TrackingMode::RAW_FILE);
+      mode == "dir"          ? OT::config::TrackingMode::DIRECTORY
+      : mode == "file"       ? OT::config::TrackingMode::FILE
+      : mode == "compressed" ? OT::config::TrackingMode::COMPRESSED_RAW_FILE
+      : mode == "stream"     ? OT::config::TrackingMode::STREAM
+                             : OT::config::TrackingMode::RAW_FILE;
   return m;
 }
 
+OT::config::PixelFormat ToPixelFormat(const std::string &format) {
+  static const std::map<std::string, OT::config::PixelFormat> formats = {
+      {"s16", OT::config::PixelFormat::S16},
+      {"u16", OT::config::PixelFormat::U16},
+      {"u14", OT::config::PixelFormat::U14},
+      {"u8", OT::config::PixelFormat::U8},
+  };
+  const auto it = formats.find(format);
+  return it == formats.cend() ? OT::config::PixelFormat::S16 : it->second;
+}
+
+OT::config::FrameValidation ToValidation(const std::string &validation) {
+  return validation == "full"
+             ? OT::config::FrameValidation::FULL
+             : (validation == "header" ? OT::config::FrameValidation::HEADER
+                                       : OT::config::FrameValidation::LAZY);
+}
+
+OT::config::DuplicateFrames ToDuplicates(const std::string &duplicates) {
+  return duplicates == "skip" ? OT::config::DuplicateFrames::SKIP
+                              : OT::config::DuplicateFrames::KEEP;
+}
+
+OT::config::ForegroundFilterMethod ToFilterMethod(const std::string &method) {
+  if (method == "reference") {
+    return OT::config::ForegroundFilterMethod::REFERENCE;
+  }
+  if (method == "bits") {
+    return OT::config::ForegroundFilterMethod::BITS;
+  }
+  return OT::config::ForegroundFilterMethod::FUSED;
+}
+
+OT::config::BackgroundModelType ToBackgroundModel(const std::string &model) {
+  if (model == "average") {
+    return OT::config::BackgroundModelType::RUNNING_AVERAGE;
+  }
+  return model == "window" ? OT::config::BackgroundModelType::RADIOMETRIC_WINDOW
+                           : OT::config::BackgroundModelType::MOG2;
+}
+
+OT::config::DetectionBackend ToDetectionBackend(const std::string &backend) {
+  return backend == "ccl" ? OT::config::DetectionBackend::CCL
+                          : OT::config::DetectionBackend::CONTOURS;
+}
+
+OT::config::PerspectiveMode ToPerspectiveMode(const std::string &mode) {
+  return mode == "points" ? OT::config::PerspectiveMode::POINTS
+                          : OT::config::PerspectiveMode::IMAGE;
+}
+
 OT::config::Config read_json(const fs::path &p_file) {
   std::ifstream file(p_file);
   nlohmann::json file_content;
@@ -66,9 +122,60 @@ OT::config::Config read_json(const fs::path &p_file) {
       file_content.value<float>("ageSuppressionThreshold", 2),
       file_content.value<double>("foregroundThresh", 130.),
       file_content.value<double>("foregroundMaxVal", 255.),
+      file_content.value<int>("sensorWidth", 384),
+      file_content.value<int>("sensorHeight", 288),
+      ToPixelFormat(file_content.value<std::string>("pixelFormat", "s16")),
+      file_content.value<double>("displayScale", 1. / 16),
+      file_content.value<bool>("rawMemoryMap", true),
+      file_content.value<std::size_t>("rawReadAheadFrames", 8),
+      file_content.value<std::size_t>("prefetchDepth", 0),
+      file_content.value<std::size_t>("prefetchThreads", 2),
+      ToValidation(file_content.value<std::string>("frameValidation", "lazy")),
+      file_content.value<std::int64_t>("startFrame", 0),
+      file_content.value<std::int64_t>("endFrame", -1),
+      file_content.value<bool>("pipelined", false),
+      file_content.value<std::size_t>("pipelineQueueDepth", 4),
+      file_content.value<bool>("realtime", false),
+      file_content.value<double>("targetFps", 30.),
+      ToDuplicates(file_content.value<std::string>("duplicateFrames", "keep")),
+      file_content.value<std::size_t>("duplicateWindow", 1),
+      ToFilterMethod(file_content.value<std::string>("foregroundFilter", "fused")),
+      ToBackgroundModel(file_content.value<std::string>("backgroundModel", "mog2")),
+      file_content.value<int>("backgroundHistory", 1000),
+      file_content.value<double>("backgroundThreshold", 100.),
+      file_content.value<double>("windowLow", std::numeric_limits<double>::quiet_NaN()),
+      file_content.value<double>("windowHigh", 32767.),
+      file_content.value<double>("radiometricGain", 1.),
+      file_content.value<double>("radiometricOffset", 0.),
+      ToDetectionBackend(file_content.value<std::string>("detectionBackend", "contours")),
+      ToPerspectiveMode(file_content.value<std::string>("perspectiveMode", "image")),
+      file_content.value<int>("detectionDecimation", 1),
+      file_content.value<int>("detectionStripes", 1),
+      fs::path{file_content.value<std::string>("backgroundSnapshot", "")},
+      file_content.value<int>("dilateIterations", 4),
   };
 }
 
+// What makes the config unusable, or an empty string when it can be used.
+std::string ConfigError(const OT::config::Config &config) {
+  if (!(config.radiometricGain > 0.)) {
+    return "radiometricGain must be positive";
+  }
+  if (config.backgroundModel == OT::config::BackgroundModelType::RADIOMETRIC_WINDOW &&
+      std::isnan(config.windowLow)) {
+    return "windowLow must be set for the window background model";
+  }
+  if (config.windowLow > config.windowHigh) {
+    return "windowLow must not be above windowHigh";
+  }
+  if (!config.backgroundSnapshot.empty() &&
+      config.backgroundModel == OT::config::BackgroundModelType::MOG2) {
+    return "backgroundSnapshot needs the average or window background model, "
+           "the state of mog2 can't be saved";
+  }
+  return {};
+}
+
 int main(int argc, char *argv[]) {
   try {
     bool showHelp = false;
@@ -94,6 +201,10 @@ int main(int argc, char *argv[]) {
 
     OT::config::Config config;
     config = read_json(inputPath);
+    if (auto error = ConfigError(config); !error.empty()) {
+      std::cerr << "Invalid config " << inputPath << ": " << error << std::endl;
+      return EXIT_FAILURE;
+    }
 
 #ifdef FMT
     OT::utils::configureLogger(config);
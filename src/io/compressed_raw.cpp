@@ -0,0 +1,315 @@
+
+
+#include "io/compressed_raw.h"
+
+#ifdef FMT
+#include "spdlog/spdlog.h"
+#endif
+
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace OT::io {
+    static_assert(std::endian::native == std::endian::little, "compressed recordings are little endian");
+
+    namespace {
+        std::uint16_t zigzag(std::uint16_t residual) {
+            return (std::uint16_t)((residual << 1) ^ (0 - (residual >> 15)));
+        }
+
+        std::uint16_t unzigzag(std::uint16_t value) {
+            return (std::uint16_t)((value >> 1) ^ (0 - (value & 1)));
+        }
+
+        // Widen the samples of a raw frame into a flat buffer.
+        template<class Sample>
+        void loadSamples(const cv::Mat &frame, std::vector<std::uint16_t> &samples) {
+            samples.resize(frame.total());
+            auto *dst = samples.data();
+            for (int y = 0; y < frame.rows; y++) {
+                const auto *src = frame.ptr<Sample>(y);
+                for (int x = 0; x < frame.cols; x++) {
+                    *dst++ = (std::uint16_t)src[x];
+                }
+            }
+        }
+
+        // Narrow a flat buffer of samples into a raw frame.
+        template<class Sample>
+        void storeSamples(const std::vector<std::uint16_t> &samples, cv::Mat &frame) {
+            const auto *src = samples.data();
+            for (int y = 0; y < frame.rows; y++) {
+                auto *dst = frame.ptr<Sample>(y);
+                for (int x = 0; x < frame.cols; x++) {
+                    dst[x] = (Sample)*src++;
+                }
+            }
+        }
+
+        // The first frame of a chunk has no previous frame, it is predicted in raster order.
+        std::uint16_t predict(const std::uint16_t *cur, const std::uint16_t *prev, std::size_t i) {
+            if (prev != nullptr) {
+                return prev[i];
+            }
+            return i == 0 ? 0 : cur[i - 1];
+        }
+
+        void encodeFrame(const std::uint16_t *cur,
+                         const std::uint16_t *prev,
+                         std::size_t count,
+                         std::vector<std::uint8_t> &out) {
+            std::uint16_t residuals[compressedBlockSize];
+
+            for (std::size_t start = 0; start < count; start += compressedBlockSize) {
+                const auto blockSize = std::min(compressedBlockSize, count - start);
+
+                std::uint16_t maxResidual = 0;
+                for (std::size_t i = 0; i < blockSize; i++) {
+                    residuals[i] = zigzag((std::uint16_t)(cur[start + i] - predict(cur, prev, start + i)));
+                    maxResidual = std::max(maxResidual, residuals[i]);
+                }
+
+                const auto bits = (int)std::bit_width(maxResidual);
+                out.push_back((std::uint8_t)bits);
+
+                std::uint64_t acc = 0;
+                int accBits = 0;
+                for (std::size_t i = 0; i < blockSize; i++) {
+                    acc |= (std::uint64_t)residuals[i] << accBits;
+                    accBits += bits;
+                    while (accBits >= 8) {
+                        out.push_back((std::uint8_t)acc);
+                        acc >>= 8;
+                        accBits -= 8;
+                    }
+                }
+                if (accBits > 0) {
+                    out.push_back((std::uint8_t)acc);
+                }
+            }
+        }
+
+        // Returns a pointer past the decoded frame, or nullptr if the data is corrupt.
+        const std::uint8_t *decodeFrame(const std::uint8_t *data,
+                                        const std::uint8_t *end,
+                                        const std::uint16_t *prev,
+                                        std::uint16_t *cur,
+                                        std::size_t count) {
+            for (std::size_t start = 0; start < count; start += compressedBlockSize) {
+                const auto blockSize = std::min(compressedBlockSize, count - start);
+
+                if (data >= end) {
+                    return nullptr;
+                }
+                const int bits = *data++;
+                const auto blockBytes = (blockSize * bits + 7) / 8;
+                if (bits > 16 || (std::size_t)(end - data) < blockBytes) {
+                    return nullptr;
+                }
+
+                const std::uint64_t mask = (1u << bits) - 1;
+                std::uint64_t acc = 0;
+                int accBits = 0;
+                for (std::size_t i = 0; i < blockSize; i++) {
+                    while (accBits < bits) {
+                        acc |= (std::uint64_t)*data++ << accBits;
+                        accBits += 8;
+                    }
+                    const auto residual = unzigzag((std::uint16_t)(acc & mask));
+                    acc >>= bits;
+                    accBits -= bits;
+
+                    cur[start + i] = (std::uint16_t)(predict(cur, prev, start + i) + residual);
+                }
+            }
+            return data;
+        }
+    }
+
+    bool parseCompressedRaw(const std::uint8_t *data,
+                            std::size_t size,
+                            CompressedRawHeader &header,
+                            const std::uint8_t *&offsets) {
+        if (size < sizeof(CompressedRawHeader)
+            || std::memcmp(data, compressedRawMagic, sizeof(compressedRawMagic)) != 0) {
+            return false;
+        }
+        std::memcpy(&header, data, sizeof(header));
+
+        if (header.version != compressedRawVersion
+            || header.headerSize < sizeof(CompressedRawHeader)
+            || header.pixelFormat > (std::uint32_t)PixelFormat::U8
+            || header.chunkFrames == 0) {
+#ifdef FMT
+            spdlog::error("Unsupported compressed recording version {}", header.version);
+#endif
+            return false;
+        }
+
+        if (header.indexOffset > size
+            || header.chunkCount >= (size - header.indexOffset) / sizeof(std::uint64_t)
+            || header.frameCount > header.chunkCount * header.chunkFrames) {
+#ifdef FMT
+            spdlog::error("Compressed recording chunk table is truncated");
+#endif
+            return false;
+        }
+
+        offsets = data + header.indexOffset;
+        std::uint64_t previousOffset = header.headerSize;
+        for (std::uint64_t i = 0; i <= header.chunkCount; i++) {
+            auto offset = compressedChunkOffset(offsets, i);
+            if (offset < previousOffset || offset > header.indexOffset) {
+#ifdef FMT
+                spdlog::error("Compressed recording chunk {} lies outside of the file", i);
+#endif
+                return false;
+            }
+            previousOffset = offset;
+        }
+        return true;
+    }
+
+    std::uint64_t compressedChunkOffset(const std::uint8_t *offsets, std::uint64_t index) {
+        std::uint64_t offset;
+        std::memcpy(&offset, offsets + index * sizeof(std::uint64_t), sizeof(offset));
+        return offset;
+    }
+
+    bool decodeCompressedChunk(const std::uint8_t *data,
+                               std::size_t size,
+                               const CompressedRawHeader &header,
+                               std::vector<cv::Mat> &frames) {
+        frames.clear();
+
+        std::uint32_t count;
+        if (size < sizeof(count)) {
+            return false;
+        }
+        std::memcpy(&count, data, sizeof(count));
+        if (count > header.chunkFrames) {
+            return false;
+        }
+
+        const auto *end = data + size;
+        data += sizeof(count);
+
+        const auto format = (PixelFormat)header.pixelFormat;
+        const std::size_t samples = (std::size_t)header.width * header.height;
+        std::vector<std::uint16_t> previous(samples), current(samples);
+
+        for (std::uint32_t f = 0; f < count; f++) {
+            data = decodeFrame(data, end, f == 0 ? nullptr : previous.data(), current.data(), samples);
+            if (data == nullptr) {
+                return false;
+            }
+
+            cv::Mat frame((int)header.height, (int)header.width, rawCvType(format));
+            if (format == PixelFormat::U8) {
+                storeSamples<std::uint8_t>(current, frame);
+            } else {
+                storeSamples<std::uint16_t>(current, frame);
+            }
+            frames.push_back(frame);
+
+            std::swap(previous, current);
+        }
+        return true;
+    }
+
+    CompressedRawWriter::~CompressedRawWriter() {
+        close();
+    }
+
+    bool CompressedRawWriter::open(const std::filesystem::path &path,
+                                   std::uint32_t width,
+                                   std::uint32_t height,
+                                   PixelFormat format,
+                                   std::uint32_t chunkFrames) {
+        close();
+
+        out.open(path, std::ios::binary | std::ios::trunc);
+        if (!out || chunkFrames == 0) {
+            return false;
+        }
+
+        header = CompressedRawHeader{};
+        std::memcpy(header.magic, compressedRawMagic, sizeof(compressedRawMagic));
+        header.version = compressedRawVersion;
+        header.headerSize = sizeof(CompressedRawHeader);
+        header.width = width;
+        header.height = height;
+        header.pixelFormat = (std::uint32_t)format;
+        header.chunkFrames = chunkFrames;
+        offsets.clear();
+        chunk.clear();
+        chunkFrameCount = 0;
+
+        // Written again with the final counts and index offset on close().
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        return (bool)out;
+    }
+
+    bool CompressedRawWriter::write(const cv::Mat &frame) {
+        const auto format = (PixelFormat)header.pixelFormat;
+        if (!out.is_open()
+            || frame.cols != (int)header.width
+            || frame.rows != (int)header.height
+            || frame.type() != rawCvType(format)) {
+            return false;
+        }
+
+        if (format == PixelFormat::U8) {
+            loadSamples<std::uint8_t>(frame, current);
+        } else {
+            loadSamples<std::uint16_t>(frame, current);
+        }
+
+        encodeFrame(current.data(), chunkFrameCount == 0 ? nullptr : previous.data(), current.size(), chunk);
+        std::swap(previous, current);
+        chunkFrameCount++;
+        header.frameCount++;
+
+        if (chunkFrameCount == header.chunkFrames) {
+            return flushChunk();
+        }
+        return (bool)out;
+    }
+
+    bool CompressedRawWriter::flushChunk() {
+        offsets.push_back((std::uint64_t)out.tellp());
+        out.write(reinterpret_cast<const char *>(&chunkFrameCount), sizeof(chunkFrameCount));
+        out.write(reinterpret_cast<const char *>(chunk.data()), (std::streamsize)chunk.size());
+
+        chunk.clear();
+        chunkFrameCount = 0;
+        return (bool)out;
+    }
+
+    bool CompressedRawWriter::close() {
+        if (!out.is_open()) {
+            return false;
+        }
+
+        if (chunkFrameCount > 0) {
+            flushChunk();
+        }
+
+        // The table ends with the offset just past the last chunk.
+        header.chunkCount = offsets.size();
+        header.indexOffset = (std::uint64_t)out.tellp();
+        offsets.push_back(header.indexOffset);
+        out.write(reinterpret_cast<const char *>(offsets.data()),
+                  (std::streamsize)(offsets.size() * sizeof(std::uint64_t)));
+
+        out.seekp(0);
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+        bool ok = (bool)out;
+        out.close();
+        return ok;
+    }
+}
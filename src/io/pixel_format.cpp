@@ -0,0 +1,42 @@
+
+
+#include "io/pixel_format.h"
+
+#include <opencv2/opencv.hpp>
+
+namespace OT::io {
+    void convertToWorking(PixelFormat format, const cv::Mat &raw, cv::Mat &working) {
+        switch (format) {
+            case PixelFormat::S16:
+                convertToWorking<PixelFormat::S16>(raw, working);
+                break;
+            case PixelFormat::U16:
+                convertToWorking<PixelFormat::U16>(raw, working);
+                break;
+            case PixelFormat::U14:
+                convertToWorking<PixelFormat::U14>(raw, working);
+                break;
+            case PixelFormat::U8:
+                convertToWorking<PixelFormat::U8>(raw, working);
+                break;
+        }
+    }
+
+    int rawCvType(PixelFormat format) {
+        switch (format) {
+            case PixelFormat::S16:
+                return PixelTraits<PixelFormat::S16>::cvType;
+            case PixelFormat::U16:
+                return PixelTraits<PixelFormat::U16>::cvType;
+            case PixelFormat::U14:
+                return PixelTraits<PixelFormat::U14>::cvType;
+            case PixelFormat::U8:
+                return PixelTraits<PixelFormat::U8>::cvType;
+        }
+        return CV_16SC1;
+    }
+
+    std::size_t bytesPerSample(PixelFormat format) {
+        return format == PixelFormat::U8 ? 1 : 2;
+    }
+}
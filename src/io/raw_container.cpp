@@ -0,0 +1,142 @@
+
+
+#include "io/raw_container.h"
+
+#ifdef FMT
+#include "spdlog/spdlog.h"
+#endif
+
+#include <opencv2/opencv.hpp>
+
+#include <bit>
+#include <cstring>
+
+namespace OT::io {
+    // Headers and offsets are written and read in native byte order.
+    static_assert(std::endian::native == std::endian::little, "raw containers are little endian");
+
+    bool isRawContainer(const std::uint8_t *data, std::size_t size) {
+        return size >= sizeof(RawContainerHeader)
+               && std::memcmp(data, rawContainerMagic, sizeof(rawContainerMagic)) == 0;
+    }
+
+    bool parseRawContainer(const std::uint8_t *data,
+                           std::size_t size,
+                           RawContainerHeader &header,
+                           const std::uint8_t *&offsets) {
+        if (!isRawContainer(data, size)) {
+            return false;
+        }
+        std::memcpy(&header, data, sizeof(header));
+
+        if (header.version != rawContainerVersion || header.headerSize < sizeof(RawContainerHeader)) {
+#ifdef FMT
+            spdlog::error("Unsupported raw container version {}", header.version);
+#endif
+            return false;
+        }
+
+        if (header.pixelFormat > (std::uint32_t)PixelFormat::U8
+            || header.cvType != rawCvType((PixelFormat)header.pixelFormat)) {
+#ifdef FMT
+            spdlog::error("Unsupported raw container pixel format {}", header.pixelFormat);
+#endif
+            return false;
+        }
+
+        const auto frameBytes = rawContainerFrameBytes(header);
+        if (header.indexOffset > size
+            || header.frameCount > (size - header.indexOffset) / sizeof(std::uint64_t)) {
+#ifdef FMT
+            spdlog::error("Raw container offset table is truncated");
+#endif
+            return false;
+        }
+
+        offsets = data + header.indexOffset;
+        for (std::uint64_t i = 0; i < header.frameCount; i++) {
+            auto offset = rawContainerOffset(offsets, i);
+            if (offset < header.headerSize || offset > size || frameBytes > size - offset) {
+#ifdef FMT
+                spdlog::error("Raw container frame {} lies outside of the file", i);
+#endif
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::uint64_t rawContainerOffset(const std::uint8_t *offsets, std::uint64_t index) {
+        std::uint64_t offset;
+        std::memcpy(&offset, offsets + index * sizeof(std::uint64_t), sizeof(offset));
+        return offset;
+    }
+
+    std::size_t rawContainerFrameBytes(const RawContainerHeader &header) {
+        return (std::size_t)header.width * header.height * CV_ELEM_SIZE(header.cvType);
+    }
+
+    RawContainerWriter::~RawContainerWriter() {
+        close();
+    }
+
+    bool RawContainerWriter::open(const std::filesystem::path &path,
+                                  std::uint32_t width,
+                                  std::uint32_t height,
+                                  PixelFormat format) {
+        close();
+
+        out.open(path, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            return false;
+        }
+
+        header = RawContainerHeader{};
+        std::memcpy(header.magic, rawContainerMagic, sizeof(rawContainerMagic));
+        header.version = rawContainerVersion;
+        header.headerSize = sizeof(RawContainerHeader);
+        header.width = width;
+        header.height = height;
+        header.cvType = rawCvType(format);
+        header.pixelFormat = (std::uint32_t)format;
+        offsets.clear();
+
+        // Written again with the final frame count and index offset on close().
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        return (bool)out;
+    }
+
+    bool RawContainerWriter::write(const cv::Mat &frame) {
+        if (!out.is_open()
+            || frame.cols != (int)header.width
+            || frame.rows != (int)header.height
+            || frame.type() != header.cvType) {
+            return false;
+        }
+
+        offsets.push_back((std::uint64_t)out.tellp());
+        const auto rowBytes = frame.cols * frame.elemSize();
+        for (int y = 0; y < frame.rows; y++) {
+            out.write(reinterpret_cast<const char *>(frame.ptr(y)), (std::streamsize)rowBytes);
+        }
+        return (bool)out;
+    }
+
+    bool RawContainerWriter::close() {
+        if (!out.is_open()) {
+            return false;
+        }
+
+        header.frameCount = offsets.size();
+        header.indexOffset = (std::uint64_t)out.tellp();
+        out.write(reinterpret_cast<const char *>(offsets.data()),
+                  (std::streamsize)(offsets.size() * sizeof(std::uint64_t)));
+
+        out.seekp(0);
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+        bool ok = (bool)out;
+        out.close();
+        return ok;
+    }
+}
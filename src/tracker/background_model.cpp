@@ -0,0 +1,219 @@
+
+
+#include "tracker/background_model.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include <opencv2/opencv.hpp>
+#include <opencv2/video/tracking.hpp>
+
+#include "utils/binary_io.h"
+
+#ifdef FMT
+#include "spdlog/spdlog.h"
+#endif
+
+namespace OT {
+    Mog2BackgroundModel::Mog2BackgroundModel(int history, int nMixtures) {
+        this->bg = cv::createBackgroundSubtractorMOG2();
+        this->bg->setHistory(history);
+        this->bg->setNMixtures(nMixtures);
+        this->bg->setDetectShadows(true);
+        this->bg->setShadowThreshold(0.7);
+    }
+
+    void Mog2BackgroundModel::apply(const cv::Mat& frame, cv::Mat& mask) {
+        this->bg->apply(frame, mask);
+    }
+
+    std::unique_ptr<BackgroundModel> Mog2BackgroundModel::createEmpty() const {
+        return std::make_unique<Mog2BackgroundModel>(this->bg->getHistory(), this->bg->getNMixtures());
+    }
+
+    RunningAverageBackgroundModel::RunningAverageBackgroundModel(int history, double threshold) {
+        this->history = std::max(history, 1);
+        this->threshold = (float)threshold;
+    }
+
+    void RunningAverageBackgroundModel::apply(const cv::Mat& frame, cv::Mat& mask) {
+        const cv::Mat* input = &frame;
+        if (frame.channels() > 1) {
+            cv::cvtColor(frame, this->gray, cv::COLOR_BGR2GRAY);
+            input = &this->gray;
+        }
+
+        // The first frame, or the first one after the geometry changed, is the background.
+        if (this->frames == 0 || this->background.size() != input->size()) {
+            input->convertTo(this->background, CV_32F);
+            mask = cv::Mat::zeros(input->size(), CV_8UC1);
+            this->frames = 1;
+            return;
+        }
+
+        this->frames = std::min<std::int64_t>(this->frames + 1, this->history);
+        const double rate = 1. / (double)this->frames;
+
+        // OpenCV's primitives are vectorized for the CPU they run on, whatever the build
+        // flags. absdiff needs the samples in the type of the average, and
+        // accumulateWeighted doesn't take the signed 16-bit working samples at all.
+        const cv::Mat* samples = input;
+        if (input->depth() != CV_32F) {
+            input->convertTo(this->samples, CV_32F);
+            samples = &this->samples;
+        }
+        cv::absdiff(*samples, this->background, this->difference);
+        cv::compare(this->difference, (double)this->threshold, mask, cv::CMP_GT);
+        cv::accumulateWeighted(*samples, this->background, rate);
+    }
+
+    bool RunningAverageBackgroundModel::classify(const cv::Mat& frame, cv::Rect roi, cv::Mat& mask) {
+        if (this->frames == 0) {
+            return false;
+        }
+
+        cv::Mat input = frame(roi);
+        if (frame.channels() > 1) {
+            cv::cvtColor(input, input, cv::COLOR_BGR2GRAY);
+        }
+
+        mask.create(roi.size(), CV_8UC1);
+        switch (input.depth()) {
+            case CV_8U:
+                this->classifyTyped<std::uint8_t>(input, frame.size(), roi.tl(), mask);
+                break;
+            case CV_16U:
+                this->classifyTyped<std::uint16_t>(input, frame.size(), roi.tl(), mask);
+                break;
+            case CV_16S:
+                this->classifyTyped<std::int16_t>(input, frame.size(), roi.tl(), mask);
+                break;
+            default:
+                this->classifyTyped<float>(input, frame.size(), roi.tl(), mask);
+                break;
+        }
+        return true;
+    }
+
+    template<class Sample>
+    void RunningAverageBackgroundModel::classifyTyped(const cv::Mat& frame,
+                                                      cv::Size frameSize,
+                                                      cv::Point offset,
+                                                      cv::Mat& mask) const {
+        cv::Mat samples = frame;
+        if (frame.depth() != cv::DataType<Sample>::depth) {
+            frame.convertTo(samples, CV_32F);
+        }
+
+        // Every pixel is compared to the average of the model pixel it falls in.
+        std::vector<int> columns(frame.cols);
+        for (int x = 0; x < frame.cols; x++) {
+            columns[x] = (int)((std::int64_t)(offset.x + x) * this->background.cols / frameSize.width);
+        }
+
+        for (int y = 0; y < frame.rows; y++) {
+            const int row = (int)((std::int64_t)(offset.y + y) * this->background.rows / frameSize.height);
+            const auto* src = samples.ptr<Sample>(y);
+            const auto* avg = this->background.ptr<float>(row);
+            auto* dst = mask.ptr<std::uint8_t>(y);
+            for (int x = 0; x < frame.cols; x++) {
+                dst[x] = std::abs((float)src[x] - avg[columns[x]]) > this->threshold ? 255 : 0;
+            }
+        }
+    }
+
+    std::unique_ptr<BackgroundModel> RunningAverageBackgroundModel::createEmpty() const {
+        return std::make_unique<RunningAverageBackgroundModel>(this->history, this->threshold);
+    }
+
+    bool RunningAverageBackgroundModel::save(std::ostream& out) const {
+        OT::utils::writeValue(out, this->frames);
+        return OT::utils::writeMat(out, this->background);
+    }
+
+    bool RunningAverageBackgroundModel::load(std::istream& in) {
+        std::int64_t savedFrames;
+        cv::Mat savedBackground;
+        if (!OT::utils::readValue(in, savedFrames) || !OT::utils::readMat(in, savedBackground)
+            || savedBackground.type() != CV_32FC1 || savedFrames < 0) {
+            return false;
+        }
+        this->frames = savedBackground.empty() ? 0 : std::min<std::int64_t>(savedFrames, this->history);
+        this->background = savedBackground;
+        return true;
+    }
+
+    RadiometricWindow::RadiometricWindow(double low, double high, double gain, double offset) {
+        // The config is validated, but the model can be made without it. Without a usable
+        // gain or window nothing is foreground.
+        if (!(gain > 0.) || std::isnan(low) || std::isnan(high)) {
+#ifdef FMT
+            spdlog::error("The radiometric window needs a positive gain and both bounds, got gain {} "
+                          "and window [{}, {}]", gain, low, high);
+#endif
+            this->low = 1.;
+            this->high = 0.;
+            return;
+        }
+
+        // Samples are whole numbers, so round the window inwards.
+        this->low = std::ceil((low - offset) / gain);
+        this->high = std::floor((high - offset) / gain);
+    }
+
+    void RadiometricWindow::apply(const cv::Mat& frame, cv::Mat& mask) {
+        const cv::Mat* input = &frame;
+        if (frame.channels() > 1) {
+            cv::cvtColor(frame, this->gray, cv::COLOR_BGR2GRAY);
+            input = &this->gray;
+        }
+        cv::inRange(*input, cv::Scalar::all(this->low), cv::Scalar::all(this->high), mask);
+    }
+
+    std::unique_ptr<BackgroundModel> RadiometricWindow::createEmpty() const {
+        // The window is kept in whole samples, which a gain of 1 leaves as they are.
+        return std::make_unique<RadiometricWindow>(this->low, this->high);
+    }
+
+    bool RadiometricWindow::save(std::ostream& out) const {
+        OT::utils::writeValue(out, this->low);
+        return OT::utils::writeValue(out, this->high);
+    }
+
+    bool RadiometricWindow::load(std::istream& in) {
+        double savedLow, savedHigh;
+        if (!OT::utils::readValue(in, savedLow) || !OT::utils::readValue(in, savedHigh)) {
+            return false;
+        }
+#ifdef FMT
+        if (savedLow != this->low || savedHigh != this->high) {
+            spdlog::warn("The snapshot was saved with the sample window [{}, {}], keeping [{}, {}]",
+                         savedLow, savedHigh, this->low, this->high);
+        }
+#endif
+        return true;
+    }
+
+    bool RadiometricWindow::classify(const cv::Mat& frame, cv::Rect roi, cv::Mat& mask) {
+        // The window doesn't depend on the resolution.
+        this->apply(frame(roi), mask);
+        return true;
+    }
+
+    std::unique_ptr<BackgroundModel> createBackgroundModel(const OT::config::Config& config) {
+        switch (config.backgroundModel) {
+            case OT::config::BackgroundModelType::RUNNING_AVERAGE:
+                return std::make_unique<RunningAverageBackgroundModel>(config.backgroundHistory,
+                                                                       config.backgroundThreshold);
+            case OT::config::BackgroundModelType::RADIOMETRIC_WINDOW:
+                return std::make_unique<RadiometricWindow>(config.windowLow,
+                                                           config.windowHigh,
+                                                           config.radiometricGain,
+                                                           config.radiometricOffset);
+            case OT::config::BackgroundModelType::MOG2:
+            default:
+                return std::make_unique<Mog2BackgroundModel>(config.backgroundHistory);
+        }
+    }
+}
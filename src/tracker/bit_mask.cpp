@@ -0,0 +1,88 @@
+
+
+#include "tracker/bit_mask.h"
+
+#include <algorithm>
+#include <bit>
+
+namespace OT {
+    void BitMask::create(int rows, int cols) {
+        this->rows = rows;
+        this->cols = cols;
+        this->words = (cols + wordBits - 1) / wordBits;
+        this->data.resize((std::size_t)rows * this->words);
+    }
+
+    void BitMask::setZero() {
+        std::fill(this->data.begin(), this->data.end(), 0);
+    }
+
+    std::uint64_t BitMask::lastWordMask() const {
+        const int used = this->cols % wordBits;
+        return used == 0 ? ~std::uint64_t(0) : (std::uint64_t(1) << used) - 1;
+    }
+
+    void BitMask::threshold(const cv::Mat& mask, int thresh) {
+        this->create(mask.rows, mask.cols);
+        this->threshold(mask, thresh, 0, mask.rows);
+    }
+
+    void BitMask::threshold(const cv::Mat& mask, int thresh, int rowBegin, int rowEnd) {
+        for (int y = rowBegin; y < rowEnd; y++) {
+            const auto* src = mask.ptr<std::uint8_t>(y);
+            auto* dst = this->row(y);
+            for (int w = 0; w < this->words; w++) {
+                const int begin = w * wordBits;
+                const int count = std::min(wordBits, this->cols - begin);
+                std::uint64_t word = 0;
+                for (int i = 0; i < count; i++) {
+                    word |= (std::uint64_t)(src[begin + i] > thresh) << i;
+                }
+                dst[w] = word;
+            }
+        }
+    }
+
+    void BitMask::toMat(cv::Mat& mat, std::uint8_t value) const {
+        mat.create(this->rows, this->cols, CV_8UC1);
+        for (int y = 0; y < this->rows; y++) {
+            const auto* src = this->row(y);
+            auto* dst = mat.ptr<std::uint8_t>(y);
+            for (int x = 0; x < this->cols; x++) {
+                dst[x] = ((src[x / wordBits] >> (x % wordBits)) & 1) ? value : 0;
+            }
+        }
+    }
+
+    int BitMask::nextSet(int y, int x) const {
+        const auto* bits = this->row(y);
+        int w = x / wordBits;
+        if (w >= this->words) {
+            return this->cols;
+        }
+        std::uint64_t word = bits[w] & (~std::uint64_t(0) << (x % wordBits));
+        while (word == 0) {
+            if (++w == this->words) {
+                return this->cols;
+            }
+            word = bits[w];
+        }
+        return w * wordBits + std::countr_zero(word);
+    }
+
+    int BitMask::nextClear(int y, int x) const {
+        const auto* bits = this->row(y);
+        int w = x / wordBits;
+        if (w >= this->words) {
+            return this->cols;
+        }
+        std::uint64_t word = ~bits[w] & (~std::uint64_t(0) << (x % wordBits));
+        while (word == 0) {
+            if (++w == this->words) {
+                return this->cols;
+            }
+            word = ~bits[w];
+        }
+        return std::min(w * wordBits + std::countr_zero(word), this->cols);
+    }
+}
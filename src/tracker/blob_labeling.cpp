@@ -0,0 +1,150 @@
+
+
+#include "tracker/blob_labeling.h"
+
+#include <algorithm>
+
+#include <opencv2/opencv.hpp>
+
+namespace OT {
+    int BlobLabeler::newLabel() {
+        this->partials.push_back({0, 0, 0, INT32_MAX, INT32_MAX, -1, -1});
+        return this->sets.add();
+    }
+
+    void BlobLabeler::start(int rows, int cols, cv::Mat* labels) {
+        this->sets.reset(0);
+        this->partials.clear();
+        this->previousRuns.clear();
+        this->currentRuns.clear();
+
+        if (labels != nullptr) {
+            labels->create(rows, cols, CV_32SC1);
+        }
+    }
+
+    void BlobLabeler::labelRow(int y, cv::Mat* labels) {
+        // The runs of both rows are in order, so the runs above that a run touches start at
+        // or after those the previous run touched.
+        std::size_t first = 0;
+        for (auto& run : this->currentRuns) {
+            // With 8-connectivity the run touches the row above from begin - 1 to end.
+            while (first < this->previousRuns.size() && this->previousRuns[first].end < run.begin) {
+                first++;
+            }
+
+            int label = -1;
+            for (std::size_t i = first; i < this->previousRuns.size() && this->previousRuns[i].begin <= run.end; i++) {
+                const int above = this->previousRuns[i].label;
+                if (label < 0) {
+                    label = above;
+                } else if (above != label) {
+                    this->sets.join(label, above);
+                }
+            }
+            if (label < 0) {
+                label = this->newLabel();
+            }
+            run.label = label;
+
+            auto& partial = this->partials[label];
+            const std::int64_t length = run.end - run.begin;
+            partial.area += length;
+            partial.sumX += length * (run.begin + run.end - 1) / 2;
+            partial.sumY += length * y;
+            partial.minX = std::min(partial.minX, run.begin);
+            partial.maxX = std::max(partial.maxX, run.end - 1);
+            partial.minY = std::min(partial.minY, y);
+            partial.maxY = std::max(partial.maxY, y);
+        }
+
+        if (labels != nullptr) {
+            auto* row = labels->ptr<int>(y);
+            std::fill(row, row + labels->cols, -1);
+            for (const auto& run : this->currentRuns) {
+                std::fill(row + run.begin, row + run.end, run.label);
+            }
+        }
+
+        std::swap(this->previousRuns, this->currentRuns);
+        this->currentRuns.clear();
+    }
+
+    void BlobLabeler::label(const cv::Mat& mask, BlobTable& blobs, cv::Mat* labels) {
+        this->start(mask.rows, mask.cols, labels);
+
+        const int cols = mask.cols;
+        for (int y = 0; y < mask.rows; y++) {
+            const auto* src = mask.ptr<std::uint8_t>(y);
+            int x = 0;
+            while (x < cols) {
+                if (src[x] == 0) {
+                    x++;
+                    continue;
+                }
+                const int begin = x;
+                while (x < cols && src[x] != 0) {
+                    x++;
+                }
+                this->currentRuns.push_back({begin, x, -1});
+            }
+            this->labelRow(y, labels);
+        }
+
+        this->finish(blobs, labels);
+    }
+
+    void BlobLabeler::label(const OT::BitMask& mask, BlobTable& blobs, cv::Mat* labels) {
+        this->start(mask.rows, mask.cols, labels);
+
+        for (int y = 0; y < mask.rows; y++) {
+            for (int x = mask.nextSet(y, 0); x < mask.cols; x = mask.nextSet(y, x)) {
+                const int begin = x;
+                x = mask.nextClear(y, x);
+                this->currentRuns.push_back({begin, x, -1});
+            }
+            this->labelRow(y, labels);
+        }
+
+        this->finish(blobs, labels);
+    }
+
+    void BlobLabeler::finish(BlobTable& blobs, cv::Mat* labels) {
+        blobs.clear();
+
+        // Fold the statistics of every label into its blob. Blobs are numbered in the order
+        // of their smallest label, which is the scan order.
+        const int count = this->sets.labelAll(this->blobOfLabel);
+        this->totals.assign(count, {0, 0, 0, INT32_MAX, INT32_MAX, -1, -1});
+        for (int label = 0; label < (int)this->partials.size(); label++) {
+            const auto& partial = this->partials[label];
+            auto& total = this->totals[this->blobOfLabel[label]];
+            total.area += partial.area;
+            total.sumX += partial.sumX;
+            total.sumY += partial.sumY;
+            total.minX = std::min(total.minX, partial.minX);
+            total.minY = std::min(total.minY, partial.minY);
+            total.maxX = std::max(total.maxX, partial.maxX);
+            total.maxY = std::max(total.maxY, partial.maxY);
+        }
+
+        for (const auto& blob : this->totals) {
+            blobs.add(cv::Point2f((float)((double)blob.sumX / (double)blob.area),
+                                  (float)((double)blob.sumY / (double)blob.area)),
+                      cv::Rect(blob.minX, blob.minY, blob.maxX - blob.minX + 1, blob.maxY - blob.minY + 1),
+                      (double)blob.area);
+        }
+
+        // Turn the provisional labels into blob indices.
+        if (labels != nullptr) {
+            for (int y = 0; y < labels->rows; y++) {
+                auto* row = labels->ptr<int>(y);
+                for (int x = 0; x < labels->cols; x++) {
+                    if (row[x] >= 0) {
+                        row[x] = this->blobOfLabel[row[x]];
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,55 @@
+
+
+#include "tracker/blob_table.h"
+
+#include <cassert>
+
+#include <opencv2/opencv.hpp>
+
+namespace OT {
+    void BlobTable::clear() {
+        centers.clear();
+        boxes.clear();
+        areas.clear();
+        outlineBegin.clear();
+        outlineEnd.clear();
+        points.clear();
+    }
+
+    void BlobTable::add(cv::Point2f center, cv::Rect box, double area) {
+        centers.push_back(center);
+        boxes.push_back(box);
+        areas.push_back(area);
+        outlineBegin.push_back((int)points.size());
+        outlineEnd.push_back((int)points.size());
+    }
+
+    void BlobTable::extendOutline(const std::vector<cv::Point>& outline) {
+        assert(!empty() && outlineEnd.back() == (int)points.size());
+        points.insert(points.end(), outline.begin(), outline.end());
+        outlineEnd.back() = (int)points.size();
+    }
+
+    cv::Mat BlobTable::outline(std::size_t i) {
+        if (outlineSize(i) == 0) {
+            return {};
+        }
+        return {outlineSize(i), 1, CV_32SC2, &points[outlineBegin[i]]};
+    }
+
+    void BlobTable::moveRow(std::size_t from, std::size_t to) {
+        centers[to] = centers[from];
+        boxes[to] = boxes[from];
+        areas[to] = areas[from];
+        outlineBegin[to] = outlineBegin[from];
+        outlineEnd[to] = outlineEnd[from];
+    }
+
+    void BlobTable::truncate(std::size_t n) {
+        centers.resize(n);
+        boxes.resize(n);
+        areas.resize(n);
+        outlineBegin.resize(n);
+        outlineEnd.resize(n);
+    }
+}
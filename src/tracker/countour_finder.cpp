@@ -2,13 +2,21 @@
 
 #include "tracker/contour_finder.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
 #include <numeric>
-#include <unordered_map>
+#include <system_error>
 
 #include <opencv2/opencv.hpp>
 #include <opencv2/video/tracking.hpp>
 
-#include "lib/disjoint_set.h"
+#include "utils/binary_io.h"
+
+#ifdef FMT
+#include "spdlog/spdlog.h"
+#endif
 
 namespace OT {
     ContourFinder::ContourFinder(int history,
@@ -16,219 +24,572 @@ namespace OT {
                                  float contourSizeThreshold,
                                  int medianFilterSize,
                                  float contourMergeThreshold) {
-        this->bg = cv::createBackgroundSubtractorMOG2();
-        this->bg->setHistory(history);
-        this->bg->setNMixtures(nMixtures);
-        this->bg->setDetectShadows(true);
-        this->bg->setShadowThreshold(0.7);
+        this->bg.push_back(std::make_unique<OT::Mog2BackgroundModel>(history, nMixtures));
         this->suppressRectangles = std::vector<cv::Rect>();
         this->contourSizeThreshold = contourSizeThreshold;
         this->medianFilterSize = medianFilterSize;
         this->contourMergeThreshold = contourMergeThreshold;
+        this->filter = OT::ForegroundFilter(medianFilterSize, this->dilateIterations);
     }
 
-    cv::Point translate(cv::Rect rect, std::pair<int, int> widthHeight) {
-        return {rect.tl().x + widthHeight.first * rect.width,
-                         rect.tl().y + widthHeight.second * rect.height};
+    void ContourFinder::setBackgroundModel(std::unique_ptr<OT::BackgroundModel> model) {
+        std::vector<std::unique_ptr<OT::BackgroundModel>> models;
+        models.push_back(std::move(model));
+        this->setBackgroundModels(std::move(models));
     }
 
-    float distanceBetweenRects(cv::Rect a, cv::Rect b) {
-        std::vector<std::pair<int, int>> pairs = {
-                std::make_pair(0, 0),
-                std::make_pair(0, 1),
-                std::make_pair(1, 0),
-                std::make_pair(1, 1)
-        };
+    void ContourFinder::setBackgroundModels(std::vector<std::unique_ptr<OT::BackgroundModel>> models) {
+        this->bg = std::move(models);
+        this->filter.stripes = (int)this->bg.size();
+    }
+
+    int ContourFinder::stripeRow(int rows, size_t stripe) const {
+        return (int)((std::int64_t)rows * (std::int64_t)stripe / (std::int64_t)this->bg.size());
+    }
+
+    void ContourFinder::applyBackground(const cv::Mat& frame) {
+        if (this->bg.size() == 1) {
+            this->bg.front()->apply(frame, this->mask);
+            return;
+        }
+
+        // The models only see their own rows. Each one writes its part of the mask in place,
+        // unless it replaces the buffer it was given.
+        this->mask.create(frame.size(), CV_8UC1);
+        cv::parallel_for_(cv::Range(0, (int)this->bg.size()), [&](const cv::Range& range) {
+            for (int i = range.start; i < range.end; i++) {
+                const int begin = this->stripeRow(frame.rows, i);
+                const int end = this->stripeRow(frame.rows, i + 1);
+                if (begin == end) {
+                    continue;
+                }
+
+                cv::Mat stripe = this->mask.rowRange(begin, end);
+                cv::Mat out = stripe;
+                this->bg[i]->apply(frame.rowRange(begin, end), out);
+                if (out.data != stripe.data) {
+                    out.copyTo(stripe);
+                }
+            }
+        });
+    }
+
+    bool ContourFinder::classify(const cv::Mat& frame, cv::Rect roi, cv::Mat& roiMask) {
+        if (this->bg.size() == 1) {
+            return this->bg.front()->classify(frame, roi, roiMask);
+        }
+
+        // Classify the part of the roi in every stripe with the model of that stripe.
+        roiMask.create(roi.size(), CV_8UC1);
+        cv::Mat part;
+        for (size_t i = 0; i < this->bg.size(); i++) {
+            const int begin = cvRound(this->stripeRow(this->mask.rows, i) * this->coarseScaleY);
+            const int end = cvRound(this->stripeRow(this->mask.rows, i + 1) * this->coarseScaleY);
+            const cv::Rect overlap = roi & cv::Rect(0, begin, frame.cols, end - begin);
+            if (overlap.empty()) {
+                continue;
+            }
+            if (!this->bg[i]->classify(frame.rowRange(begin, end), overlap - cv::Point(0, begin), part)) {
+                return false;
+            }
+            part.copyTo(roiMask(overlap - roi.tl()));
+        }
+        return true;
+    }
+
+    void ContourFinder::setFilterMethod(OT::config::ForegroundFilterMethod method) {
+        this->filter.method = method;
+    }
+
+    void ContourFinder::setDilateIterations(int iterations) {
+        this->dilateIterations = std::max(iterations, 0);
+        this->rebuildFilter();
+    }
+
+    void ContourFinder::rebuildFilter() {
+        auto method = this->filter.method;
+        auto stripes = this->filter.stripes;
+        this->filter = OT::ForegroundFilter(this->medianFilterSize, this->dilateIterations, method);
+        this->filter.stripes = stripes;
+    }
+
+    void ContourFinder::setDetectionBackend(OT::config::DetectionBackend backend) {
+        this->backend = backend;
+    }
+
+    bool ContourFinder::usesBitMask() const {
+        // cv::findContours needs the byte mask anyway.
+        return this->filter.method == OT::config::ForegroundFilterMethod::BITS
+               && this->backend == OT::config::DetectionBackend::CCL;
+    }
+
+    void ContourFinder::setDecimation(int decimation) {
+        this->decimation = std::max(decimation, 1);
+    }
+
+    bool ContourFinder::canSnapshot() const {
+        return std::all_of(this->bg.cbegin(), this->bg.cend(),
+                           [](const auto& model) { return model->savable(); });
+    }
+
+    bool ContourFinder::saveSnapshot(const std::filesystem::path& path) const {
+        if (!this->canSnapshot()) {
+            return false;
+        }
+
+        // Write next to the file and replace it only once everything is written, so a
+        // failed save keeps the last good snapshot.
+        auto temporary = path;
+        temporary += ".tmp";
+        if (!this->writeSnapshot(temporary)) {
+            std::error_code error;
+            std::filesystem::remove(temporary, error);
+            return false;
+        }
+        std::error_code error;
+        std::filesystem::rename(temporary, path, error);
+        return !error;
+    }
+
+    bool ContourFinder::writeSnapshot(const std::filesystem::path& path) const {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            return false;
+        }
+
+        BackgroundSnapshotHeader header{};
+        std::memcpy(header.magic, backgroundSnapshotMagic, sizeof(backgroundSnapshotMagic));
+        header.version = backgroundSnapshotVersion;
+        header.headerSize = sizeof(BackgroundSnapshotHeader);
+        header.modelType = (std::uint32_t)this->bg.front()->type();
+        header.stripes = (std::uint32_t)this->bg.size();
+        header.detectionBackend = (std::uint32_t)this->backend;
+        header.decimation = this->decimation;
+        header.medianFilterSize = this->medianFilterSize;
+        header.dilateIterations = this->dilateIterations;
+        header.contourSizeThreshold = this->contourSizeThreshold;
+        header.contourMergeThreshold = this->contourMergeThreshold;
+        header.suppressCount = (std::uint32_t)this->suppressRectangles.size();
+        OT::utils::writeValue(out, header);
+
+        for (const auto& rect : this->suppressRectangles) {
+            const std::int32_t values[4] = {rect.x, rect.y, rect.width, rect.height};
+            OT::utils::writeValue(out, values);
+        }
+
+        for (const auto& model : this->bg) {
+            if (!model->save(out)) {
+                return false;
+            }
+        }
+        out.close();
+        return !out.fail();
+    }
+
+    bool ContourFinder::loadSnapshot(const std::filesystem::path& path) {
+        if (!this->canSnapshot()) {
+            return false;
+        }
+
+        std::ifstream in(path, std::ios::binary);
+        BackgroundSnapshotHeader header{};
+        // The models have learned frames of the decimated size, so the decimation must match.
+        if (!OT::utils::readValue(in, header)
+            || std::memcmp(header.magic, backgroundSnapshotMagic, sizeof(backgroundSnapshotMagic)) != 0
+            || header.version != backgroundSnapshotVersion
+            || header.headerSize < sizeof(BackgroundSnapshotHeader)
+            || header.modelType != (std::uint32_t)this->bg.front()->type()
+            || header.stripes != this->bg.size()
+            || header.decimation != this->decimation) {
+            return false;
+        }
+        in.seekg(header.headerSize);
+
+        // The rectangles are only compared with the current ones.
+        std::vector<cv::Rect> rectangles;
+        for (std::uint32_t i = 0; i < header.suppressCount; i++) {
+            std::int32_t values[4];
+            if (!OT::utils::readValue(in, values)) {
+                return false;
+            }
+            rectangles.emplace_back(values[0], values[1], values[2], values[3]);
+        }
 
-        double minDist = cv::norm(a.tl() - b.tl());
-        for (size_t i = 0; i < pairs.size(); i++) {
-            for (size_t j = 0; j < pairs.size(); j++) {
-                minDist = std::min(minDist,
-                                   cv::norm(translate(a, pairs[i])
-                                            - translate(b, pairs[j])
-                                   )
-                );
+        // Load into new models and only replace the current ones once all of them loaded.
+        std::vector<std::unique_ptr<OT::BackgroundModel>> models;
+        for (const auto& model : this->bg) {
+            models.push_back(model->createEmpty());
+            if (!models.back()->load(in)) {
+                return false;
             }
         }
-        return (float)minDist;
+
+#ifdef FMT
+        // The models don't depend on these, the configured ones are kept.
+        if (header.detectionBackend != (std::uint32_t)this->backend
+            || header.medianFilterSize != this->medianFilterSize
+            || header.dilateIterations != this->dilateIterations
+            || header.contourSizeThreshold != this->contourSizeThreshold
+            || header.contourMergeThreshold != this->contourMergeThreshold
+            || rectangles != this->suppressRectangles) {
+            spdlog::warn("{} was saved with other detection parameters, keeping the configured ones",
+                         path.string());
+        }
+#endif
+
+        this->bg = std::move(models);
+        return true;
     }
 
     /**
-     * Remove contours if they are are too small.
+     * The smallest distance between a corner of `a` and a corner of `b`, with the corners
+     * at x or x + width and y or y + height. The horizontal and vertical offsets of the
+     * closest pair of corners are independent of each other, so each is minimized on its own.
      */
-    void ContourFinder::filterOutBadContours(std::vector<std::vector<cv::Point>>& contours) const {
-        std::vector<double> areas(contours.size());
-
-        // Find the area of each contour.
-        std::transform(contours.cbegin(),
-                       contours.cend(),
-                       areas.begin(),
-                       [](const std::vector<cv::Point>& contour) {
-                           return cv::contourArea(contour);
-                       });
-
-        // Select the largest contour.
-        double maxArea = std::accumulate(areas.cbegin(),
-                                         areas.cend(),
-                                         0,
-                                         [](double prevMaxArea, double area) {
-                                             return std::max(prevMaxArea, area);
-                                         });
-
-        // Create the threshold.
-        int threshold = this->contourSizeThreshold * maxArea;
-
-        // Remove contours that have a size less than the threshold.
-        auto removeThese = std::remove_if(contours.begin(), contours.end(), [threshold](const std::vector<cv::Point>& contour) {
-            return cv::contourArea(contour) <= threshold;
+    float distanceBetweenRects(cv::Rect a, cv::Rect b) {
+        auto closest = [](int a0, int a1, int b0, int b1) {
+            return std::min(std::min(std::abs(a0 - b0), std::abs(a0 - b1)),
+                            std::min(std::abs(a1 - b0), std::abs(a1 - b1)));
+        };
+        const double dx = closest(a.x, a.x + a.width, b.x, b.x + b.width);
+        const double dy = closest(a.y, a.y + a.height, b.y, b.y + b.height);
+        return (float)std::sqrt(dx * dx + dy * dy);
+    }
+
+    void ContourFinder::findClosePairs(const std::vector<cv::Rect>& boxes, float distance) {
+        this->closePairs.clear();
+
+        // Sweep over the boxes from left to right. A pair of corners is never closer than the
+        // gap between the boxes along one axis, so once that gap reaches `distance` no box
+        // further right can be close.
+        this->sweepOrder.resize(boxes.size());
+        std::iota(this->sweepOrder.begin(), this->sweepOrder.end(), 0);
+        std::sort(this->sweepOrder.begin(), this->sweepOrder.end(), [&boxes](int i, int j) {
+            return boxes[i].x < boxes[j].x || (boxes[i].x == boxes[j].x && i < j);
         });
-        contours.erase(removeThese, contours.end());
+
+        for (size_t p = 0; p < this->sweepOrder.size(); p++) {
+            const auto& a = boxes[this->sweepOrder[p]];
+            for (size_t q = p + 1; q < this->sweepOrder.size(); q++) {
+                const auto& b = boxes[this->sweepOrder[q]];
+                if ((float)(b.x - (a.x + a.width)) >= distance) {
+                    break;
+                }
+                const int gapY = std::max(b.y - (a.y + a.height), a.y - (b.y + b.height));
+                if ((float)gapY >= distance || distanceBetweenRects(a, b) >= distance) {
+                    continue;
+                }
+                this->closePairs.emplace_back(std::min(this->sweepOrder[p], this->sweepOrder[q]),
+                                              std::max(this->sweepOrder[p], this->sweepOrder[q]));
+            }
+        }
+
+        // Merging depends on the order the pairs are joined in, keep that of a nested loop.
+        std::sort(this->closePairs.begin(), this->closePairs.end());
+    }
+
+    int ContourFinder::groupCloseBoxes(const std::vector<cv::Rect>& boxes) {
+        this->findClosePairs(boxes, this->contourMergeThreshold * this->diagonal);
+
+        this->mergeSets.reset((int)boxes.size());
+        for (const auto& [i, j] : this->closePairs) {
+            this->mergeSets.join(i, j);
+        }
+        const int count = this->mergeSets.labelAll(this->setOfBox);
+
+        // Sort the boxes by group with a counting sort, which keeps them in order within a
+        // group. Placing a box advances the start of its group to the start of the next one,
+        // so the starts are shifted back afterwards.
+        this->mergeStart.assign(count + 1, 0);
+        for (int group : this->setOfBox) {
+            this->mergeStart[group + 1]++;
+        }
+        std::partial_sum(this->mergeStart.begin(), this->mergeStart.end(), this->mergeStart.begin());
+        this->mergeMembers.resize(boxes.size());
+        for (size_t i = 0; i < boxes.size(); i++) {
+            this->mergeMembers[this->mergeStart[this->setOfBox[i]]++] = (int)i;
+        }
+        for (int group = count - 1; group > 0; group--) {
+            this->mergeStart[group] = this->mergeStart[group - 1];
+        }
+        this->mergeStart[0] = 0;
+        return count;
+    }
+
+    void ContourFinder::addContours(OT::BlobTable& blobs) {
+        // Find the area of each contour, and the largest one.
+        this->contourAreas.resize(this->rawContours.size());
+        double maxArea = 0;
+        for (size_t i = 0; i < this->rawContours.size(); i++) {
+            this->contourAreas[i] = cv::contourArea(this->rawContours[i]);
+            maxArea = std::max(maxArea, this->contourAreas[i]);
+        }
+
+        // Create the threshold, in whole pixels.
+        const int threshold = (int)(this->contourSizeThreshold * std::floor(maxArea));
+
+        // Keep the contours that have a size above the threshold.
+        for (size_t i = 0; i < this->rawContours.size(); i++) {
+            if (this->contourAreas[i] <= threshold) {
+                continue;
+            }
+            blobs.add(cv::Point2f(), cv::Rect(), this->contourAreas[i]);
+            blobs.extendOutline(this->rawContours[i]);
+            this->measureOutline(blobs, blobs.size() - 1);
+        }
     }
 
     void ContourFinder::findContours(const cv::Mat& frame,
-                                     std::vector<cv::Vec4i>& hierarchy,
-                                     std::vector<std::vector<cv::Point>>& contours,
-                                     std::vector<cv::Point2f>& massCenters,
-                                     std::vector<cv::Rect>& boundingBoxes,
+                                     OT::BlobTable& blobs,
                                      double foregroundThresh,
                                      double foregroundMaxVal) {
+        // Most of the work happens on the decimated frame, if there is one.
+        const cv::Mat* input = &frame;
+        if (this->decimation > 1) {
+            cv::resize(frame, this->coarse,
+                       cv::Size(std::max(frame.cols / this->decimation, 1), std::max(frame.rows / this->decimation, 1)),
+                       0, 0, cv::INTER_AREA);
+            input = &this->coarse;
+        }
+        this->coarseScaleX = (double)frame.cols / input->cols;
+        this->coarseScaleY = (double)frame.rows / input->rows;
+
         // Set the diagonal.
-        this->diagonal = (float)std::sqrt(frame.rows * frame.rows + frame.cols * frame.cols);
+        this->diagonal = (float)std::sqrt(input->rows * input->rows + input->cols * input->cols);
 
-        // First clear the conotour and hierarchy objects.
-        contours.clear();
-        hierarchy.clear();
+        // First clear the blobs of the previous frame.
+        blobs.clear();
 
         // Find the foreground.
-        this->bg->apply(frame, this->foreground);
-        cv::threshold(this->foreground, this->foreground, foregroundThresh, foregroundMaxVal, cv::ThresholdTypes::THRESH_BINARY);
+        this->applyBackground(*input);
 
-        // Get rid little specks of noise by doing a median blur.
-        // The median blur is good for salt-and-pepper noise, not Gaussian noise.
-        cv::medianBlur(this->foreground, this->foreground, this->medianFilterSize);
-
-        // Dilate the image to make the blobs larger.
-        cv::dilate(this->foreground, this->foreground, cv::Mat());
-        cv::dilate(this->foreground, this->foreground, cv::Mat());
-        cv::dilate(this->foreground, this->foreground, cv::Mat());
-        cv::dilate(this->foreground, this->foreground, cv::Mat());
+        // Threshold it, remove specks of noise with a median blur and make the blobs larger.
+        if (this->usesBitMask()) {
+            this->filter.apply(this->mask, this->foregroundBits, foregroundThresh, foregroundMaxVal);
+            if (this->showWindows || input != &frame) {
+                this->foregroundBits.toMat(this->foreground, cv::saturate_cast<std::uint8_t>(cvRound(foregroundMaxVal)));
+            }
+        } else {
+            this->filter.apply(this->mask, this->foreground, foregroundThresh, foregroundMaxVal);
+        }
 
+#ifndef OT_HEADLESS
         if(showWindows){
             cv::imshow("foreground", this->foreground);
         }
+#endif
 
-        // Find the contours.
-        cv::findContours(this->foreground, contours, hierarchy, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE, cv::Point(0, 0));
-
-        // Keep only those contours that are sufficiently large.
-        this->filterOutBadContours(contours);
+        if (this->backend == OT::config::DetectionBackend::CCL) {
+            this->findBlobs(blobs);
+        } else {
+            // Find the contours.
+            cv::findContours(this->foreground, this->rawContours, this->hierarchy, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE, cv::Point(0, 0));
 
-        // Get the mass centers and bounding boxes.
-        OT::ContourFinder::getCentersAndBoundingBoxes(contours, massCenters, boundingBoxes);
+            // Keep only those contours that are sufficiently large, with their mass centers
+            // and bounding boxes.
+            this->addContours(blobs);
 
-        // Remove any mass centers that appear in the suppressed rectangles.
-        this->suppressMassCenters(contours, massCenters, boundingBoxes);
+            // Remove any mass centers that appear in the suppressed rectangles.
+            this->suppressMassCenters(blobs);
 
-        // Merge nearby contours.
-        this->mergeContours(contours, massCenters, boundingBoxes);
+            // Merge nearby contours.
+            this->mergeContours(blobs);
+        }
 
-        // Now find the mass centers and bounding boxes again.
-        OT::ContourFinder::getCentersAndBoundingBoxes(contours, massCenters, boundingBoxes);
+        if (input != &frame) {
+            this->refine(frame, blobs);
+        }
     }
 
-    void ContourFinder::mergeContours(std::vector<std::vector<cv::Point> > &contours,
-                                      const std::vector<cv::Point2f>& massCenters,
-                                      const std::vector<cv::Rect>& boundingBoxes) const {
-        DisjointSets sets(contours.size());
-        for (size_t i = 0; i < contours.size(); i++) {
-            for (size_t j = i + 1; j < contours.size(); j++) {
-                // Measure the distance between the mass centers,
-                // and if it's small enough, merge them.
-                if (distanceBetweenRects(boundingBoxes[i], boundingBoxes[j]) <
-                    this->contourMergeThreshold * this->diagonal) {
-                    sets.Union(i, j);
+    void ContourFinder::refine(const cv::Mat& frame, OT::BlobTable& blobs) {
+        const double sx = this->coarseScaleX;
+        const double sy = this->coarseScaleY;
+        const cv::Rect frameRect(0, 0, frame.cols, frame.rows);
+
+        for (size_t i = 0; i < blobs.size(); i++) {
+            const auto& box = blobs.boxes[i];
+            const cv::Rect roi = cv::Rect(cv::Point(cvFloor(box.x * sx), cvFloor(box.y * sy)),
+                                          cv::Point(cvCeil((box.x + box.width) * sx), cvCeil((box.y + box.height) * sy)))
+                                 & frameRect;
+
+            // Without a full resolution classification, scale the coarse blob up.
+            blobs.centers[i] = cv::Point2f((float)((blobs.centers[i].x + 0.5) * sx - 0.5),
+                                           (float)((blobs.centers[i].y + 0.5) * sy - 0.5));
+            blobs.boxes[i] = roi;
+            blobs.areas[i] *= sx * sy;
+            if (roi.empty() || !this->classify(frame, roi, this->roiMask)) {
+                continue;
+            }
+
+            // Only keep the pixels that lie in the coarse foreground, the box may overlap others.
+            for (int y = 0; y < roi.height; y++) {
+                const auto* coarseRow = this->foreground.ptr<std::uint8_t>(std::min((int)((roi.y + y) / sy), this->foreground.rows - 1));
+                auto* row = this->roiMask.ptr<std::uint8_t>(y);
+                for (int x = 0; x < roi.width; x++) {
+                    if (coarseRow[std::min((int)((roi.x + x) / sx), this->foreground.cols - 1)] == 0) {
+                        row[x] = 0;
+                    }
                 }
             }
-        }
 
-        // Create a map such that the values are the sets of
-        // indices of contours that should be merged.
-        std::unordered_map<int, std::vector<int>> itemsForSet;
-        for (size_t i = 0; i < contours.size(); i++) {
-            if (itemsForSet.find(sets.FindSet(i)) == itemsForSet.end()) {
-                itemsForSet.insert(std::pair<int, std::vector<int>>(sets.FindSet(i), std::vector<int>()));
+            const auto moments = cv::moments(this->roiMask, true);
+            if (moments.m00 > 0) {
+                blobs.centers[i] = cv::Point2f((float)(roi.x + moments.m10 / moments.m00),
+                                               (float)(roi.y + moments.m01 / moments.m00));
+                blobs.boxes[i] = cv::boundingRect(this->roiMask) + roi.tl();
+                blobs.areas[i] = moments.m00;
             }
-            itemsForSet[sets.FindSet(i)].push_back(i);
         }
 
-        // Now merge the contours.
-        std::vector<std::vector<cv::Point>> newContours;
-        for (auto kv : itemsForSet) {
-            // If there's only one item, just add it without doing any merge.
-            if (kv.second.size() == 1) {
-                newContours.push_back(contours[kv.first]);
+        // The outlines are only for display, stretching them is good enough.
+        for (auto& point : blobs.points) {
+            point = cv::Point(cvRound(point.x * sx), cvRound(point.y * sy));
+        }
+    }
+
+    bool ContourFinder::isSuppressed(const cv::Point2f& massCenter) const {
+        // Suppressed rectangles are given on the full resolution frame.
+        const cv::Point2f center((float)((massCenter.x + 0.5) * this->coarseScaleX - 0.5),
+                                 (float)((massCenter.y + 0.5) * this->coarseScaleY - 0.5));
+        return std::any_of(this->suppressRectangles.cbegin(),
+                           this->suppressRectangles.cend(),
+                           [&](const cv::Rect& rect) {
+                               return rect.contains(center);
+                           });
+    }
+
+    void ContourFinder::findBlobs(OT::BlobTable& blobs) {
+        cv::Mat* blobLabels = this->showWindows ? &this->labels : nullptr;
+        if (this->usesBitMask()) {
+            this->labeler.label(this->foregroundBits, this->labeled, blobLabels);
+        } else {
+            this->labeler.label(this->foreground, this->labeled, blobLabels);
+        }
+
+        // Keep the blobs that are sufficiently large and outside of the suppressed rectangles,
+        // by the same rules the contour backend applies.
+        double maxArea = 0;
+        for (auto area : this->labeled.areas) {
+            maxArea = std::max(maxArea, area);
+        }
+        const float threshold = this->contourSizeThreshold * (float)maxArea;
+
+        this->kept.clear();
+        for (size_t i = 0; i < this->labeled.size(); i++) {
+            if (this->labeled.areas[i] <= threshold) {
                 continue;
             }
-
-            // Combine all the points of every contour
-            // that must be merged into the vector<vector<Point>> aggregate.
-            auto aggregate = contours[kv.second[0]];
-            for (size_t i = 1; i < kv.second.size(); i++) {
-                std::copy(contours[kv.second[i]].cbegin(),
-                          contours[kv.second[i]].cend(),
-                          std::back_inserter(aggregate));
+            if (!this->isSuppressed(this->labeled.centers[i])) {
+                this->kept.push_back((int)i);
             }
+        }
 
-            // Now use the merged contours instead of the original contours.
-            newContours.push_back(aggregate);
+        // Merge nearby blobs. The merged blob has the total area, the area weighted centroid
+        // and the union of the bounding boxes.
+        this->keptBoxes.clear();
+        for (int blob : this->kept) {
+            this->keptBoxes.push_back(this->labeled.boxes[blob]);
         }
+        const int count = this->groupCloseBoxes(this->keptBoxes);
+
+        for (int group = 0; group < count; group++) {
+            const int membersBegin = this->mergeStart[group];
+            const int membersEnd = this->mergeStart[group + 1];
+
+            double area = 0., sumX = 0., sumY = 0.;
+            cv::Rect box = this->labeled.boxes[this->kept[this->mergeMembers[membersBegin]]];
+            for (int k = membersBegin; k < membersEnd; k++) {
+                const int blob = this->kept[this->mergeMembers[k]];
+                const auto blobArea = this->labeled.areas[blob];
+                area += blobArea;
+                sumX += blobArea * this->labeled.centers[blob].x;
+                sumY += blobArea * this->labeled.centers[blob].y;
+                box |= this->labeled.boxes[blob];
+            }
+            blobs.add(cv::Point2f((float)(sumX / area), (float)(sumY / area)), box, area);
 
-        // Replace the old contours with the new ones.
-        contours.clear();
-        std::copy(newContours.cbegin(), newContours.cend(), std::back_inserter(contours));
+            // Outlines are only traced for display.
+            if (!this->showWindows) {
+                continue;
+            }
+            for (int k = membersBegin; k < membersEnd; k++) {
+                const int blob = this->kept[this->mergeMembers[k]];
+                const auto& blobBox = this->labeled.boxes[blob];
+                cv::Mat blobMask = this->labels(blobBox) == blob;
+
+                cv::findContours(blobMask, this->blobOutlines, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE, blobBox.tl());
+                for (const auto& outline : this->blobOutlines) {
+                    blobs.extendOutline(outline);
+                }
+            }
+        }
     }
 
-    void ContourFinder::getCentersAndBoundingBoxes(const std::vector<std::vector<cv::Point> > &contours,
-                                                   std::vector<cv::Point2f> &massCenters,
-                                                   std::vector<cv::Rect> &boundingBoxes) {
-        // Empty the vectors.
-        massCenters.clear();
-        boundingBoxes.clear();
+    void ContourFinder::mergeContours(OT::BlobTable& blobs) {
+        // Find the bounding boxes that are close enough, and merge them.
+        const int count = this->groupCloseBoxes(blobs.boxes);
+
+        // A group is at or before the position of its first contour, so rows only move to
+        // lower positions and are read before they are overwritten.
+        for (int group = 0; group < count; group++) {
+            const int membersBegin = this->mergeStart[group];
+            const int membersEnd = this->mergeStart[group + 1];
 
-        // Create local variables.
-        cv::Moments contourMoments;
-        std::vector<std::vector<cv::Point> > contourPolygons(contours.size());
+            // If there's only one item, just keep it without doing any merge.
+            if (membersEnd - membersBegin == 1) {
+                blobs.moveRow(this->mergeMembers[membersBegin], group);
+                continue;
+            }
 
-        // Iterate through every contour.
-        for (size_t i = 0; i < contours.size(); i++) {
-            // Compute the center of mass.
-            contourMoments = cv::moments(contours[i], false);
-            massCenters.emplace_back(contourMoments.m10/contourMoments.m00, contourMoments.m01/contourMoments.m00);
+            // Append the points of every contour of the group to the points, one after the other.
+            int size = 0;
+            double area = 0.;
+            for (int k = membersBegin; k < membersEnd; k++) {
+                size += blobs.outlineSize(this->mergeMembers[k]);
+                area += blobs.areas[this->mergeMembers[k]];
+            }
+            const int begin = (int)blobs.points.size();
+            blobs.points.resize(begin + size);
+            auto out = blobs.points.begin() + begin;
+            for (int k = membersBegin; k < membersEnd; k++) {
+                const int member = this->mergeMembers[k];
+                out = std::copy(blobs.points.begin() + blobs.outlineBegin[member],
+                                blobs.points.begin() + blobs.outlineEnd[member],
+                                out);
+            }
 
-            // Compute the polygon represented by the contour, and then compute the bounding box around that polygon.
-            cv::approxPolyDP(cv::Mat(contours[i]), contourPolygons[i], 3, true);
-            boundingBoxes.push_back(cv::boundingRect(cv::Mat(contourPolygons[i])));
+            // Now use the merged contour instead of the original contours.
+            blobs.areas[group] = area;
+            blobs.outlineBegin[group] = begin;
+            blobs.outlineEnd[group] = begin + size;
+            this->measureOutline(blobs, group);
         }
+        blobs.truncate(count);
+    }
+
+    void ContourFinder::measureOutline(OT::BlobTable& blobs, std::size_t row) {
+        const cv::Mat outline = blobs.outline(row);
+
+        // Compute the center of mass.
+        const auto moments = cv::moments(outline, false);
+        blobs.centers[row] = cv::Point2f((float)(moments.m10 / moments.m00), (float)(moments.m01 / moments.m00));
+
+        // Compute the polygon represented by the contour, and then compute the bounding box around that polygon.
+        cv::approxPolyDP(outline, this->polygon, 3, true);
+        blobs.boxes[row] = cv::boundingRect(this->polygon);
     }
 
     void ContourFinder::suppressRectangle(cv::Rect rect) {
         this->suppressRectangles.push_back(rect);
     }
 
-    void ContourFinder::suppressMassCenters(std::vector<std::vector<cv::Point> > &contours,
-                                            std::vector<cv::Point2f> &massCenters,
-                                            std::vector<cv::Rect> &boundingBoxes) {
-        for (size_t i = 0; i < contours.size(); i++) {
-            for (auto & suppressRectangle : this->suppressRectangles) {
-                if (suppressRectangle.contains(massCenters[i])) {
-                    contours.erase(contours.begin() + i);
-                    massCenters.erase(massCenters.begin() + i);
-                    boundingBoxes.erase(boundingBoxes.begin() + i);
-                    i--;
-                    break;
-                }
+    void ContourFinder::suppressMassCenters(OT::BlobTable& blobs) {
+        size_t count = 0;
+        for (size_t i = 0; i < blobs.size(); i++) {
+            if (!this->isSuppressed(blobs.centers[i])) {
+                blobs.moveRow(i, count++);
             }
         }
+        blobs.truncate(count);
     }
 }
-
@@ -0,0 +1,482 @@
+
+
+#include "tracker/foreground_filter.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+
+#include <opencv2/opencv.hpp>
+
+namespace OT {
+    namespace {
+        // The loops below work on whole rows and are simple enough for the compiler to vectorize.
+        void addThresholded(const std::uint8_t* src, std::uint16_t* counts, int cols, int thresh) {
+            for (int x = 0; x < cols; x++) {
+                counts[x] += src[x] > thresh;
+            }
+        }
+
+        void subtractThresholded(const std::uint8_t* src, std::uint16_t* counts, int cols, int thresh) {
+            for (int x = 0; x < cols; x++) {
+                counts[x] -= src[x] > thresh;
+            }
+        }
+
+        // One row of the median: set where more than half of the k x k window is set. The
+        // window slides over the column counts, replicated at the left and right border like
+        // cv::medianBlur does.
+        void medianRow(const std::vector<std::uint16_t>& counts,
+                       std::vector<std::uint16_t>& padded,
+                       int k,
+                       std::uint8_t* dst) {
+            const int cols = (int)counts.size();
+            const int half = k / 2;
+            std::fill(padded.begin(), padded.begin() + half, counts.front());
+            std::copy(counts.begin(), counts.end(), padded.begin() + half);
+            std::fill(padded.begin() + half + cols, padded.end(), counts.back());
+
+            const unsigned needed = k * k / 2 + 1;
+            unsigned sum = 0;
+            for (int x = 0; x < k; x++) {
+                sum += padded[x];
+            }
+            for (int x = 0; x < cols; x++) {
+                dst[x] = sum >= needed;
+                if (x + 1 < cols) {
+                    sum += padded[x + k];
+                    sum -= padded[x];
+                }
+            }
+        }
+
+        // One row of the dilation: set where any column within `radius` has a set median pixel
+        // in the window. Columns outside the frame are ignored, like the default border of cv::dilate.
+        void dilateRow(const std::vector<std::uint16_t>& counts, int radius, std::uint8_t value, std::uint8_t* dst) {
+            const int cols = (int)counts.size();
+            int covered = 0;
+            for (int x = 0; x <= std::min(radius, cols - 1); x++) {
+                covered += counts[x] > 0;
+            }
+            for (int x = 0; x < cols; x++) {
+                dst[x] = covered > 0 ? value : 0;
+                if (x + radius + 1 < cols) {
+                    covered += counts[x + radius + 1] > 0;
+                }
+                if (x - radius >= 0) {
+                    covered -= counts[x - radius] > 0;
+                }
+            }
+        }
+    }
+
+    namespace {
+        constexpr int wordBits = OT::BitMask::wordBits;
+
+        // Bit-sliced counters: word w of slice b holds bit b of the counts of the 64 pixels
+        // of word w. Add or subtract one row of bits to all of them.
+        void addBitRow(std::uint64_t* slices, int sliceCount, int words, const std::uint64_t* bits) {
+            for (int w = 0; w < words; w++) {
+                std::uint64_t carry = bits[w];
+                for (int b = 0; b < sliceCount && carry != 0; b++) {
+                    auto& slice = slices[(std::size_t)b * words + w];
+                    const std::uint64_t next = slice & carry;
+                    slice ^= carry;
+                    carry = next;
+                }
+            }
+        }
+
+        void subtractBitRow(std::uint64_t* slices, int sliceCount, int words, const std::uint64_t* bits) {
+            for (int w = 0; w < words; w++) {
+                std::uint64_t borrow = bits[w];
+                for (int b = 0; b < sliceCount && borrow != 0; b++) {
+                    auto& slice = slices[(std::size_t)b * words + w];
+                    const std::uint64_t next = ~slice & borrow;
+                    slice ^= borrow;
+                    borrow = next;
+                }
+            }
+        }
+
+        bool getBit(const std::uint64_t* bits, int x) {
+            return (bits[x / wordBits] >> (x % wordBits)) & 1;
+        }
+
+        void setBit(std::uint64_t* bits, int x) {
+            bits[x / wordBits] |= std::uint64_t(1) << (x % wordBits);
+        }
+
+        // dst = src moved `shift` bits towards higher columns (shift > 0) or lower ones, with
+        // zeros shifted in. Both hold `words` words.
+        void shiftBits(const std::uint64_t* src, std::uint64_t* dst, int words, int shift) {
+            const int wordShift = std::abs(shift) / wordBits;
+            const int bitShift = std::abs(shift) % wordBits;
+            for (int w = 0; w < words; w++) {
+                std::uint64_t value = 0;
+                if (shift > 0) {
+                    const int from = w - wordShift;
+                    if (from >= 0) {
+                        value = src[from] << bitShift;
+                        if (bitShift != 0 && from > 0) {
+                            value |= src[from - 1] >> (wordBits - bitShift);
+                        }
+                    }
+                } else {
+                    const int from = w + wordShift;
+                    if (from < words) {
+                        value = src[from] >> bitShift;
+                        if (bitShift != 0 && from + 1 < words) {
+                            value |= src[from + 1] << (wordBits - bitShift);
+                        }
+                    }
+                }
+                dst[w] = value;
+            }
+        }
+
+        // The 64 bits of `bits` starting at bit `offset`.
+        std::uint64_t bitsAt(const std::uint64_t* bits, int offset) {
+            const int w = offset / wordBits;
+            const int s = offset % wordBits;
+            return s == 0 ? bits[w] : (bits[w] >> s) | (bits[w + 1] << (wordBits - s));
+        }
+    }
+
+    ForegroundFilter::ForegroundFilter(int medianSize,
+                                       int dilateIterations,
+                                       OT::config::ForegroundFilterMethod method) {
+        this->method = method;
+        this->medianSize = medianSize;
+        this->dilateIterations = dilateIterations;
+    }
+
+    void ForegroundFilter::apply(const cv::Mat& mask, cv::Mat& filtered, double thresh, double maxVal) {
+        if (mask.empty()) {
+            filtered.release();
+            return;
+        }
+
+        if (this->method == OT::config::ForegroundFilterMethod::REFERENCE) {
+            this->applyReference(mask, filtered, thresh, maxVal);
+            return;
+        }
+
+        // The same rounding as cv::threshold on 8-bit images. Below 0 every pixel is set,
+        // from 255 on none is.
+        const int ithresh = std::clamp(cvFloor(thresh), -1, 255);
+        const auto value = cv::saturate_cast<std::uint8_t>(cvRound(maxVal));
+
+        if (this->method == OT::config::ForegroundFilterMethod::BITS && this->bitsSupported()) {
+            this->applyBits(mask, this->packed, ithresh);
+            this->packed.toMat(filtered, value);
+            return;
+        }
+
+        filtered.create(mask.size(), CV_8UC1);
+        this->forEachStripe(mask.rows, [&](int rowBegin, int rowEnd, Scratch& scratch) {
+            this->applyFused(mask, filtered, ithresh, value, rowBegin, rowEnd, scratch);
+        });
+    }
+
+    void ForegroundFilter::apply(const cv::Mat& mask, OT::BitMask& filtered, double thresh, double maxVal) {
+        const auto value = cv::saturate_cast<std::uint8_t>(cvRound(maxVal));
+        if (mask.empty() || value == 0
+            || this->method != OT::config::ForegroundFilterMethod::BITS || !this->bitsSupported()) {
+            this->apply(mask, this->bytes, thresh, maxVal);
+            filtered.threshold(this->bytes, 0);
+            return;
+        }
+
+        this->applyBits(mask, filtered, std::clamp(cvFloor(thresh), -1, 255));
+    }
+
+    template<class Stage>
+    void ForegroundFilter::forEachStripe(int rows, const Stage& stage) {
+        const int stripeCount = std::clamp(this->stripes, 1, std::max(rows, 1));
+        this->stripeScratch.resize(stripeCount);
+        if (stripeCount == 1) {
+            stage(0, rows, this->stripeScratch[0]);
+            return;
+        }
+
+        cv::parallel_for_(cv::Range(0, stripeCount), [&](const cv::Range& range) {
+            for (int i = range.start; i < range.end; i++) {
+                stage((int)((std::int64_t)rows * i / stripeCount),
+                      (int)((std::int64_t)rows * (i + 1) / stripeCount),
+                      this->stripeScratch[i]);
+            }
+        });
+    }
+
+    bool ForegroundFilter::bitsSupported() const {
+        return this->medianSize <= 255;
+    }
+
+    void ForegroundFilter::applyReference(const cv::Mat& mask, cv::Mat& filtered, double thresh, double maxVal) const {
+        cv::threshold(mask, filtered, thresh, maxVal, cv::ThresholdTypes::THRESH_BINARY);
+
+        // Get rid little specks of noise by doing a median blur.
+        // The median blur is good for salt-and-pepper noise, not Gaussian noise.
+        cv::medianBlur(filtered, filtered, this->medianSize);
+
+        // Dilate the image to make the blobs larger. OpenCV grows the 3x3 kernel to a
+        // (2n+1)x(2n+1) one and applies it as separable row and column passes, which gives the
+        // same mask as n separate dilations.
+        if (this->dilateIterations > 0) {
+            cv::dilate(filtered, filtered, cv::Mat(), cv::Point(-1, -1), this->dilateIterations);
+        }
+    }
+
+    void ForegroundFilter::applyFused(const cv::Mat& mask,
+                                      cv::Mat& filtered,
+                                      int thresh,
+                                      std::uint8_t value,
+                                      int rowBegin,
+                                      int rowEnd,
+                                      Scratch& scratch) const {
+        const int rows = mask.rows;
+        const int cols = mask.cols;
+        const int half = this->medianSize / 2;
+        const int radius = this->dilateIterations;
+        const int ringRows = 2 * radius + 1;
+
+        scratch.columnCounts.assign(cols, 0);
+        scratch.paddedCounts.resize(cols + 2 * half);
+        scratch.medianRing.resize((std::size_t)ringRows * cols);
+        scratch.dilateCounts.assign(cols, 0);
+
+        // Rows above and below the mask repeat its first and last row, like cv::medianBlur.
+        auto maskRow = [&mask, rows](int y) {
+            return mask.ptr<std::uint8_t>(std::clamp(y, 0, rows - 1));
+        };
+
+        // The output rows need the median rows within `radius` of them.
+        const int firstMedian = std::max(0, rowBegin - radius);
+        for (int dy = -half; dy <= half; dy++) {
+            addThresholded(maskRow(firstMedian + dy), scratch.columnCounts.data(), cols, thresh);
+        }
+
+        int nextMedian = firstMedian;
+        int oldestMedian = firstMedian;
+        for (int y = rowBegin; y < rowEnd; y++) {
+            const int lo = std::max(0, y - radius);
+            const int hi = std::min(rows - 1, y + radius);
+
+            // Median rows that left the dilation window free their slot in the ring first.
+            for (; oldestMedian < lo; oldestMedian++) {
+                const auto *med = &scratch.medianRing[(std::size_t)(oldestMedian % ringRows) * cols];
+                for (int x = 0; x < cols; x++) {
+                    scratch.dilateCounts[x] -= med[x];
+                }
+            }
+
+            for (; nextMedian <= hi; nextMedian++) {
+                // Slide the median window down to nextMedian.
+                if (nextMedian > firstMedian) {
+                    subtractThresholded(maskRow(nextMedian - 1 - half), scratch.columnCounts.data(), cols, thresh);
+                    addThresholded(maskRow(nextMedian + half), scratch.columnCounts.data(), cols, thresh);
+                }
+
+                auto *med = &scratch.medianRing[(std::size_t)(nextMedian % ringRows) * cols];
+                medianRow(scratch.columnCounts, scratch.paddedCounts, this->medianSize, med);
+                for (int x = 0; x < cols; x++) {
+                    scratch.dilateCounts[x] += med[x];
+                }
+            }
+
+            dilateRow(scratch.dilateCounts, radius, value, filtered.ptr<std::uint8_t>(y));
+        }
+    }
+
+    void ForegroundFilter::applyBits(const cv::Mat& mask, OT::BitMask& filtered, int thresh) {
+        const int rows = mask.rows;
+        this->thresholdedBits.create(rows, mask.cols);
+        this->medianBits.create(rows, mask.cols);
+        filtered.create(rows, mask.cols);
+
+        // Every step reads rows of the previous one that belong to neighbouring stripes, so
+        // the steps run one after another.
+        this->forEachStripe(rows, [&](int rowBegin, int rowEnd, Scratch&) {
+            this->thresholdedBits.threshold(mask, thresh, rowBegin, rowEnd);
+        });
+        this->forEachStripe(rows, [&](int rowBegin, int rowEnd, Scratch& scratch) {
+            this->medianBitRows(rowBegin, rowEnd, scratch);
+        });
+        this->forEachStripe(rows, [&](int rowBegin, int rowEnd, Scratch& scratch) {
+            this->dilateBitRows(filtered, rowBegin, rowEnd, scratch);
+        });
+    }
+
+    void ForegroundFilter::medianBitRows(int rowBegin, int rowEnd, Scratch& scratch) {
+        const auto& src = this->thresholdedBits;
+        auto& dst = this->medianBits;
+        const int rows = src.rows;
+        const int cols = src.cols;
+        const int words = src.words;
+        const int k = this->medianSize;
+        const int half = k / 2;
+
+        // Column counts go up to k, window sums up to k * k.
+        const int countBits = std::bit_width((unsigned)k);
+        const int sumBits = std::bit_width((unsigned)(k * k));
+        const unsigned needed = k * k / 2 + 1;
+
+        // Padded rows hold the counts of columns -half to cols + half, and a spare word so
+        // that bitsAt() can always read the word after.
+        const int paddedWords = (cols + 2 * half + wordBits - 1) / wordBits + 1;
+        scratch.countSlices.assign((std::size_t)countBits * words, 0);
+        scratch.paddedSlices.resize((std::size_t)countBits * paddedWords);
+
+        // Rows above and below the mask repeat its first and last row, like cv::medianBlur.
+        auto srcRow = [&src, rows](int y) {
+            return src.row(std::clamp(y, 0, rows - 1));
+        };
+
+        for (int dy = -half; dy <= half; dy++) {
+            addBitRow(scratch.countSlices.data(), countBits, words, srcRow(rowBegin + dy));
+        }
+
+        const std::uint64_t lastWordMask = src.lastWordMask();
+        for (int y = rowBegin; y < rowEnd; y++) {
+            if (y > rowBegin) {
+                subtractBitRow(scratch.countSlices.data(), countBits, words, srcRow(y - 1 - half));
+                addBitRow(scratch.countSlices.data(), countBits, words, srcRow(y + half));
+            }
+
+            // Move every slice `half` columns to the right and replicate the border columns.
+            for (int b = 0; b < countBits; b++) {
+                const auto* slice = &scratch.countSlices[(std::size_t)b * words];
+                auto* padded = &scratch.paddedSlices[(std::size_t)b * paddedWords];
+                std::fill(padded, padded + paddedWords, 0);
+                for (int w = 0; w < words; w++) {
+                    const int bit = w * wordBits + half;
+                    padded[bit / wordBits] |= slice[w] << (bit % wordBits);
+                    if (bit % wordBits != 0) {
+                        padded[bit / wordBits + 1] |= slice[w] >> (wordBits - bit % wordBits);
+                    }
+                }
+                if (getBit(slice, 0)) {
+                    for (int x = 0; x < half; x++) {
+                        setBit(padded, x);
+                    }
+                }
+                if (getBit(slice, cols - 1)) {
+                    for (int x = cols + half; x < cols + 2 * half; x++) {
+                        setBit(padded, x);
+                    }
+                }
+            }
+
+            auto* out = dst.row(y);
+            for (int w = 0; w < words; w++) {
+                // Sum the counts of the k columns of the window with a bit-sliced adder.
+                std::array<std::uint64_t, 16> sum{};
+                for (int j = 0; j < k; j++) {
+                    std::uint64_t carry = 0;
+                    for (int b = 0; b < sumBits; b++) {
+                        const std::uint64_t addend = b < countBits
+                                ? bitsAt(&scratch.paddedSlices[(std::size_t)b * paddedWords], w * wordBits + j)
+                                : 0;
+                        if (b >= countBits && carry == 0) {
+                            break;
+                        }
+                        const std::uint64_t partial = sum[b] ^ addend;
+                        const std::uint64_t nextCarry = (sum[b] & addend) | (partial & carry);
+                        sum[b] = partial ^ carry;
+                        carry = nextCarry;
+                    }
+                }
+
+                // sum >= needed, from the most significant bit down.
+                std::uint64_t greater = 0;
+                std::uint64_t equal = ~std::uint64_t(0);
+                for (int b = sumBits - 1; b >= 0; b--) {
+                    if ((needed >> b) & 1) {
+                        equal &= sum[b];
+                    } else {
+                        greater |= equal & sum[b];
+                        equal &= ~sum[b];
+                    }
+                }
+                out[w] = greater | equal;
+            }
+            out[words - 1] &= lastWordMask;
+        }
+    }
+
+    void ForegroundFilter::dilateBitRows(OT::BitMask& filtered, int rowBegin, int rowEnd, Scratch& scratch) const {
+        const auto& src = this->medianBits;
+        const int rows = src.rows;
+        const int words = src.words;
+        const int radius = this->dilateIterations;
+        const int window = 2 * radius + 1;
+        const std::uint64_t lastWordMask = src.lastWordMask();
+
+        scratch.rowBits.resize(words);
+        scratch.shiftedUp.resize(words);
+        scratch.shiftedDown.resize(words);
+        scratch.suffixRows.resize((std::size_t)window * words);
+        scratch.prefixRow.resize(words);
+        scratch.zeroRow.assign(words, 0);
+        auto& bits = scratch.rowBits;
+
+        // Rows outside the mask are clear, like the default border of cv::dilate.
+        auto srcRow = [&src, &scratch, rows](int y) {
+            return y < 0 || y >= rows ? scratch.zeroRow.data() : src.row(y);
+        };
+
+        // Vertically, the window of row y covers the rows y - radius to y + radius. Cut the
+        // rows into blocks of the window's height, the first one starting at the window of
+        // rowBegin. A window then either is a whole block or spans the end of one block and
+        // the start of the next, so it is the OR of a suffix of one and a prefix of the
+        // other. Both are built up one row at a time, a row costs the same for any radius.
+        for (int blockBegin = rowBegin - radius; blockBegin + radius < rowEnd; blockBegin += window) {
+            // suffixRows[j] is the OR of the rows blockBegin + j to the end of the block.
+            auto* suffix = scratch.suffixRows.data();
+            std::copy_n(srcRow(blockBegin + window - 1), words, &suffix[(std::size_t)(window - 1) * words]);
+            for (int j = window - 2; j >= 0; j--) {
+                const auto* row = srcRow(blockBegin + j);
+                const auto* next = &suffix[(std::size_t)(j + 1) * words];
+                auto* current = &suffix[(std::size_t)j * words];
+                for (int w = 0; w < words; w++) {
+                    current[w] = row[w] | next[w];
+                }
+            }
+
+            // prefixRow is the OR of the first j rows of the next block.
+            auto& prefix = scratch.prefixRow;
+            std::fill(prefix.begin(), prefix.end(), 0);
+            for (int j = 0; j < window && blockBegin + j + radius < rowEnd; j++) {
+                const int y = blockBegin + j + radius;
+                if (j > 0) {
+                    const auto* row = srcRow(blockBegin + window + j - 1);
+                    for (int w = 0; w < words; w++) {
+                        prefix[w] |= row[w];
+                    }
+                }
+                const auto* current = &suffix[(std::size_t)j * words];
+                for (int w = 0; w < words; w++) {
+                    bits[w] = current[w] | prefix[w];
+                }
+
+                // Horizontally, each step widens the set runs by `step` columns on both sides.
+                // A step may be as large as the distance already covered plus one without
+                // leaving gaps, so the covered distance doubles.
+                for (int covered = 0; covered < radius;) {
+                    const int step = std::min(covered + 1, radius - covered);
+                    shiftBits(bits.data(), scratch.shiftedUp.data(), words, step);
+                    shiftBits(bits.data(), scratch.shiftedDown.data(), words, -step);
+                    for (int w = 0; w < words; w++) {
+                        bits[w] |= scratch.shiftedUp[w] | scratch.shiftedDown[w];
+                    }
+                    // Bits past the last column must not come back in the next step.
+                    bits[words - 1] &= lastWordMask;
+                    covered += step;
+                }
+
+                std::copy(bits.begin(), bits.end(), filtered.row(y));
+            }
+        }
+    }
+}
@@ -42,18 +42,24 @@ namespace OT {
         this->kf->statePost.at<float>(1, 0) = startPt.y;
 
         // Create the matrices.
+        cv::setIdentity(this->kf->measurementMatrix);
+        this->magnitudeOfAccelerationNoise = magnitudeOfAccelerationNoise;
+        this->setTimeStep(dt);
+
+        cv::setIdentity(this->kf->measurementNoiseCov, cv::Scalar::all(0.1));
+        cv::setIdentity(this->kf->errorCovPost, cv::Scalar::all(0.1));
+    }
+
+    void KalmanTracker::setTimeStep(float dt) {
+        this->dt = dt;
         this->kf->transitionMatrix = (cv::Mat_<float>(4, 4) << 1,0,dt,0,   0,1,0,dt,  0,0,1,0,  0,0,0,1);
 
-        cv::setIdentity(this->kf->measurementMatrix);
         this->kf->processNoiseCov = (cv::Mat_<float>(4, 4) <<
                                                            pow(dt,4.0)/4.0, 0, pow(dt,3.0)/2.0, 0,
                 0, pow(dt,4.0)/4.0 , 0 ,pow(dt,3.0)/2.0,
                 pow(dt,3.0)/2.0, 0, pow(dt,2.0), 0,
                 0, pow(dt,3.0)/2.0, 0, pow(dt,2.0));
-        this->kf->processNoiseCov *= magnitudeOfAccelerationNoise;
-
-        cv::setIdentity(this->kf->measurementNoiseCov, cv::Scalar::all(0.1));
-        cv::setIdentity(this->kf->errorCovPost, cv::Scalar::all(0.1));
+        this->kf->processNoiseCov *= this->magnitudeOfAccelerationNoise;
     }
 
     cv::Point KalmanTracker::correct(cv::Point pt) {
@@ -67,7 +73,10 @@ namespace OT {
         return statePt;
     }
 
-    cv::Point KalmanTracker::predict() {
+    cv::Point KalmanTracker::predict(float dt) {
+        if (dt != this->dt) {
+            this->setTimeStep(dt);
+        }
         cv::Mat prediction = this->kf->predict();
         cv::Point predictedPt(prediction.at<float>(0), prediction.at<float>(1));
         this->kf->statePre.copyTo(this->kf->statePost);
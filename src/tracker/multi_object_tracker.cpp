@@ -31,10 +31,13 @@ namespace OT {
         this->dt = dt;
     }
 
-    void MultiObjectTracker::update(const std::vector<cv::Point2f>& massCenters,
-                                    const std::vector<cv::Rect>& boundingRects,
-                                    std::vector<OT::TrackingOutput>& trackingOutputs) {
+    void MultiObjectTracker::update(const OT::BlobTable& blobs,
+                                    std::vector<OT::TrackingOutput>& trackingOutputs,
+                                    float dt) {
+        const auto& massCenters = blobs.centers;
+        const auto& boundingRects = blobs.boxes;
         trackingOutputs.clear();
+        this->dt = dt;
 
         // If we haven't found any mass centers, just update all the Kalman filters and return their predictions.
         if (massCenters.empty()) {
@@ -51,7 +54,7 @@ namespace OT {
             // Update the remaining trackers.
             for (auto & kalmanTracker : this->kalmanTrackers) {
                 if (kalmanTracker.getLifetime() > lifetimeThreshold) {
-                    kalmanTracker.predict();
+                    kalmanTracker.predict(this->dt);
                     trackingOutputs.push_back(kalmanTracker.latestTrackingOutput());
                 }
             }
@@ -144,12 +147,14 @@ namespace OT {
 
         // Create new trackers for the unassigned mass centers.
         for (int i : centersWithoutKalman) {
-            this->kalmanTrackers.emplace_back(massCenters[i]);
+            this->kalmanTrackers.emplace_back(massCenters[i],
+                                              this->dt,
+                                              this->magnitudeOfAccelerationNoise);
         }
 
         // Update the Kalman filters.
         for (size_t i = 0; i < assignment.size(); i++) {
-            this->kalmanTrackers[i].predict();
+            this->kalmanTrackers[i].predict(this->dt);
             if (assignment[i] != -1) {
                 this->kalmanTrackers[i].correct(massCenters[assignment[i]]);
                 this->kalmanTrackers[i].gotUpdate();
@@ -17,98 +17,234 @@
 #include "opencv2/opencv.hpp"
 #include "opencv2/video/tracking.hpp"
 
+#include <array>
 #include <filesystem>
 #include <vector>
 #include <set>
 #include <thread>
 #include <cstdlib>
 #include <algorithm>
+#include <charconv>
 
 namespace fs = std::filesystem;
 
 namespace OT::tracking{
     namespace fs = std::filesystem;
 
-    static const double alpha = 1. / 16;
-
-    bool matEquals(const cv::Mat& lhs, const cv::Mat& rhs){
-        return cv::sum(cv::sum(lhs != rhs)).val[0] == 0;
-    }
-
     bool FramesDirCapture::open(const cv::String &dirname, int apiPreference, const std::vector<int> &params) {
         auto dir = fs::path{dirname};
         if(!(fs::is_directory(dir) && fs::exists(dir))){
             return false;
         }
 
+        // The workers read from `filenames`, stop them before it changes.
+        prefetcher.reset();
+        filenames.clear();
+        cur_index = 0;
+        already_grabbed = false;
+        forgetRecentHashes();
+
+        const auto abs_dir = fs::absolute(dir).lexically_normal();
+
+        // Listing the directory is sequential, everything else is done in parallel.
+        std::vector<fs::path> entries;
+        for(const auto &entry: fs::directory_iterator(abs_dir)){
+            if(entry.is_regular_file()){
+                entries.push_back(entry.path().filename());
+            }
+        }
+
 #ifdef FMT
-        spdlog::info("Checking valid images in directory...");
+        spdlog::info("Indexing {} files in directory...", entries.size());
 #endif
-        for(auto &file: fs::directory_iterator(dir)){
-            if(fs::is_regular_file(file)){
-                auto abs_path = fs::absolute(file.path()).lexically_normal();
-                auto name_without_ext = abs_path.stem();
+        std::vector<std::pair<std::uint64_t, fs::path>> index(entries.size());
+        std::vector<std::uint8_t> valid(entries.size(), 0);
+
+        cv::parallel_for_(cv::Range(0, (int)entries.size()), [&](const cv::Range &range){
+            for(int i = range.start; i < range.end; i++){
+                const auto stem = entries[i].stem().string();
 
                 std::uint64_t file_num;
-                {
-                    std::stringstream ss;
-                    ss << name_without_ext.string();
-                    if(!(ss >> file_num)){
-                        continue;
-                    }
+                auto [ptr, ec] = std::from_chars(stem.data(), stem.data() + stem.size(), file_num);
+                if(ec != std::errc() || ptr == stem.data()){
+                    continue;
                 }
-                cv::Mat img = cv::imread(abs_path.string());
-                if(img.data != nullptr){
-                    filenames[file_num] = abs_path;
+
+                auto abs_path = abs_dir / entries[i];
+                switch(validation){
+                    case config::FrameValidation::FULL:
+                        if(cv::imread(abs_path.string()).empty()){
+                            continue;
+                        }
+                        break;
+                    case config::FrameValidation::HEADER:
+                        if(!cv::haveImageReader(abs_path.string())){
+                            continue;
+                        }
+                        break;
+                    case config::FrameValidation::LAZY:
+                        break;
                 }
+
+                index[i] = {file_num, std::move(abs_path)};
+                valid[i] = 1;
+            }
+        });
+
+        filenames.reserve(index.size());
+        for(std::size_t i = 0; i < index.size(); i++){
+            if(valid[i]){
+                filenames.push_back(std::move(index[i]));
             }
         }
 
-        cur_iter = filenames.begin();
+        // Several files may share a number (e.g. 1.png and 1.jpg), only one of them is used.
+        std::sort(filenames.begin(), filenames.end());
+        filenames.erase(std::unique(filenames.begin(), filenames.end(),
+                                    [](const auto &lhs, const auto &rhs){ return lhs.first == rhs.first; }),
+                        filenames.end());
+
 #ifdef FMT
-        spdlog::info("Count of valid images in directory \"{}\" is {}", dirname, std::to_string(filenames.size()));
+        spdlog::info("Count of indexed images in directory \"{}\" is {}", dirname, std::to_string(filenames.size()));
 #endif
+
+        startPrefetch();
         return true;
     }
 
+    void FramesDirCapture::startPrefetch() {
+        prefetcher.reset();
+        if(prefetchDepth == 0){
+            return;
+        }
+
+        // Workers decode in filename order and stay at most prefetchDepth frames ahead.
+        prefetcher = std::make_unique<OT::utils::OrderedPrefetcher<DecodedFrame>>(
+                filenames.size(),
+                [this](std::size_t i){
+                    return decode(filenames[i].second);
+                },
+                prefetchDepth,
+                prefetchThreads,
+                cur_index);
+    }
+
+    bool FramesDirCapture::set(int propId, double value) {
+        if(propId != cv::CAP_PROP_POS_FRAMES || value < 0 || value > (double)filenames.size()){
+            return false;
+        }
+
+        cur_index = (std::size_t)value;
+        already_grabbed = false;
+        forgetRecentHashes();
+        startPrefetch();
+        return true;
+    }
+
+    double FramesDirCapture::get(int propId) const {
+        switch(propId){
+            case cv::CAP_PROP_POS_FRAMES:
+                return (double)(cur_index - (already_grabbed ? 1 : 0));
+            case cv::CAP_PROP_FRAME_COUNT:
+                return (double)filenames.size();
+            default:
+                return 0.;
+        }
+    }
+
     FramesDirCapture& FramesDirCapture::operator>>(cv::Mat &image){
 #ifdef FMT
         spdlog::trace("Getting image from stream...");
 #endif
-        if(this->grab()){
-            cur_iter++;
+        if(!already_grabbed){
+            this->grab();
         }
-
         image = cur_image;
+        already_grabbed = false;
         return *this;
     }
 
+    FramesDirCapture::DecodedFrame FramesDirCapture::decode(const fs::path &filename) {
+        DecodedFrame frame;
+        frame.image = cv::imread(filename.string());
+        if(!frame.image.empty()){
+            frame.hash = OT::utils::frameHash(frame.image);
+        }
+        return frame;
+    }
+
+    bool FramesDirCapture::seenRecently(std::uint64_t hash) {
+        const bool seen = recentOccurrences.count(hash) > 0;
+
+        // The oldest hash leaves the ring once it is full.
+        if(recentCount == recentHashes.size()){
+            auto oldest = recentOccurrences.find(recentHashes[recentNext]);
+            if(--oldest->second == 0){
+                recentOccurrences.erase(oldest);
+            }
+        } else {
+            recentCount++;
+        }
+        recentHashes[recentNext] = hash;
+        recentNext = (recentNext + 1) % recentHashes.size();
+        recentOccurrences[hash]++;
+
+        return seen;
+    }
+
+    void FramesDirCapture::forgetRecentHashes() {
+        recentCount = 0;
+        recentNext = 0;
+        recentOccurrences.clear();
+    }
+
     bool FramesDirCapture::grab() {
-        if(cur_iter == filenames.end()){
+        // Files that weren't validated up front are skipped here if they can't be decoded,
+        // and so are duplicates if asked to.
+        DecodedFrame frame;
+        while(frame.image.empty()){
+            if(cur_index >= filenames.size()){
 #ifdef FMT
-            spdlog::info("End of files");
+                spdlog::info("End of files");
 #endif
-            return false;
-        }
-        auto filename = cur_iter->second;
+                return false;
+            }
+            const auto &filename = filenames[cur_index++].second;
+
+            if(prefetcher != nullptr){
+                prefetcher->pop(frame);
+            } else {
 #ifdef FMT
-        spdlog::debug("Reading {} ...", fs::absolute(filename).string());
+                spdlog::debug("Reading {} ...", filename.string());
 #endif
-        cv::Mat image = cv::imread(filename.string());
+                frame = decode(filename);
+            }
+            if(frame.image.empty()){
 #ifdef FMT
-        spdlog::trace("Size of read image is {}x{}", image.size[0], image.size[1]);
+                spdlog::warn("Skipping invalid image {}", filename.string());
 #endif
-        if(image.size != cur_image.size || !matEquals(image, cur_image)){
+                continue;
+            }
+
+            if(seenRecently(frame.hash)){
+                if(duplicates == OT::config::DuplicateFrames::SKIP){
 #ifdef FMT
-            spdlog::debug("Image changed");
-            spdlog::debug("Grabbing new image with size {}", image.size);
+                    spdlog::debug("Skipping duplicate image {}", filename.string());
 #endif
-            cur_image = image;
-            return true;
+                    frame.image.release();
+                    continue;
+                }
+#ifdef FMT
+                spdlog::warn("New image is equal to a recent one");
+#endif
+            }
         }
+        already_grabbed = true;
+
 #ifdef FMT
-        spdlog::warn("New image is equal to previous");
+        spdlog::trace("Size of read image is {}x{}", frame.image.size[0], frame.image.size[1]);
 #endif
+        cur_image = frame.image;
         return true;
     }
 
@@ -129,10 +265,25 @@ namespace OT::tracking{
                     capture = std::make_unique<cv::VideoCapture>();
                     break;
                 case config::TrackingMode::DIRECTORY:
-                    capture = std::make_unique<FramesDirCapture>();
+                    capture = std::make_unique<FramesDirCapture>(config.prefetchDepth,
+                                                                 config.prefetchThreads,
+                                                                 config.frameValidation,
+                                                                 config.duplicateFrames,
+                                                                 config.duplicateWindow);
+                    break;
+                case config::TrackingMode::COMPRESSED_RAW_FILE:
+                    capture = std::make_unique<CompressedRawCapture>(config.prefetchDepth, config.prefetchThreads);
+                    break;
+                case config::TrackingMode::STREAM:
+                    capture = std::make_unique<StreamCapture>(cv::Size(config.sensorWidth, config.sensorHeight),
+                                                              config.pixelFormat);
                     break;
                 case config::TrackingMode::RAW_FILE:
-                    capture = std::make_unique<RawFileCapture>();
+                    capture = std::make_unique<RawFileCapture>(config.rawMemoryMap,
+                                                               config.rawReadAheadFrames,
+                                                               cv::Size(config.sensorWidth, config.sensorHeight),
+                                                               config.pixelFormat,
+                                                               config.pipelined);
                     break;
             }
             capture->open(config.inputPath.string());
@@ -143,6 +294,12 @@ namespace OT::tracking{
         OT::perspective::extractFourPoints(perspectivePoints, points);
         if (!points.empty()) {
             perspectiveMatrix = OT::perspective::getPerspectiveMatrix(points, perspectiveSize);
+            pointSpace = config.perspectiveMode == config::PerspectiveMode::POINTS;
+            if (pointSpace) {
+                planeSize = OT::utils::scaledSize(perspectiveSize, maxDimension);
+            } else {
+                warpScale = OT::perspective::WarpScaleMap(perspectiveMatrix, perspectiveSize, maxDimension);
+            }
         }
 
 #ifdef FMT
@@ -152,98 +309,343 @@ namespace OT::tracking{
         }
 #endif
 
+        // Jump to the first frame of the requested range. Frame numbers stay absolute.
+        if(config.startFrame > 0){
+            if(capture->set(cv::CAP_PROP_POS_FRAMES, (double)config.startFrame)){
+                frameNumber = (std::uint64_t)config.startFrame;
+            }
+#ifdef FMT
+            else {
+                spdlog::error("Video source can't seek to frame {}", config.startFrame);
+            }
+#endif
+        }
+
         contourFinder.showWindows = show_windows;
+        contourFinder.setFilterMethod(config.foregroundFilter);
+        contourFinder.setDilateIterations(config.dilateIterations);
+        contourFinder.setDetectionBackend(config.detectionBackend);
+        contourFinder.setDecimation(config.detectionDecimation);
+
+        // One background model per stripe of the frame.
+        std::vector<std::unique_ptr<OT::BackgroundModel>> backgroundModels;
+        for (int i = 0; i < std::max(config.detectionStripes, 1); i++) {
+            backgroundModels.push_back(OT::createBackgroundModel(config));
+        }
+        contourFinder.setBackgroundModels(std::move(backgroundModels));
+
+        // Continue with the background of an earlier run.
+        if (!config.backgroundSnapshot.empty() && fs::exists(config.backgroundSnapshot)) {
+            load_background(config.backgroundSnapshot);
+        }
     }
 
     void Tracker::run() {
-
-        static const std::double_t needed_fps = 30.;
-        static const auto needed_frame_time = std::chrono::duration<std::double_t>{1 / needed_fps};
-
-        std::double_t fps = 0.;
-        std::uint64_t frames = 0;
-        std::chrono::duration<double> deltaTime{0.};
-
+#ifndef OT_HEADLESS
         if(show_windows){
             // Set the mouse callback.
             cv::namedWindow("Video");
             cv::namedWindow("Original");
         }
+#endif
 
-        cv::Mat frame;
+        if(config.pipelined){
+            runPipelined();
+        } else {
+            auto start = std::chrono::steady_clock::now();
+            std::uint64_t frames = 0;
 
-        // Repeat while the user has not pressed "q" and while there's another frame.
+            FramePacket packet;
+            while(nextFrame(packet)) {
+#ifdef FMT
+                spdlog::trace("Got new image from stream");
+#endif
+                preprocess(packet);
+                detect(packet);
+                associate(packet);
+                emit(packet);
+                frames++;
+            }
 
-        //Error here Seg Dump OT::utils::hasFrame(*capture)
-        while(OT::utils::hasFrame(*capture)) {
+            logThroughput(frames, std::chrono::steady_clock::now() - start);
+        }
 
-            auto start = std::chrono::steady_clock::now();
+        if (!config.backgroundSnapshot.empty()) {
+            save_background(config.backgroundSnapshot);
+        }
+    }
 
-            // Fetch the next frame.
-            *capture >> frame;
+    bool Tracker::save_background(const std::filesystem::path& path) const {
+        if (!contourFinder.canSnapshot()) {
 #ifdef FMT
+            spdlog::error("The background model can't be saved exactly, not writing {}", path.string());
+#endif
+            return false;
+        }
 
-            spdlog::trace("Got new image from stream");
+        bool saved = contourFinder.saveSnapshot(path);
+#ifdef FMT
+        if (saved) {
+            spdlog::info("Saved the background to {}", path.string());
+        } else {
+            spdlog::error("Could not save the background to {}", path.string());
+        }
 #endif
-            track_frame(frame);
+        return saved;
+    }
 
-            auto end = std::chrono::steady_clock::now();
-            std::chrono::duration<double> elapsed_seconds = end - start;
+    bool Tracker::load_background(const std::filesystem::path& path) {
+        if (!contourFinder.canSnapshot()) {
+#ifdef FMT
+            spdlog::error("The background model can't be restored exactly, not reading {}", path.string());
+#endif
+            return false;
+        }
 
-            deltaTime += elapsed_seconds;
-            frames++;
+        bool loaded = contourFinder.loadSnapshot(path);
+#ifdef FMT
+        if (loaded) {
+            spdlog::info("Restored the background from {}", path.string());
+        } else {
+            spdlog::error("{} is not a background snapshot for this background model, number of stripes "
+                          "and detection decimation", path.string());
+        }
+#endif
+        return loaded;
+    }
 
+    bool Tracker::nextFrame(FramePacket& packet) {
+        using clock = std::chrono::steady_clock;
 
-            if( std::chrono::duration_cast<std::chrono::seconds>(deltaTime) >= std::chrono::milliseconds{100}){
-                fps = frames * 0.7 + fps * 0.3; // stable
-                frames = 0;
-                deltaTime -= std::chrono::milliseconds {100};
+        // Let go of the previous frame first, so the capture can reuse its buffer.
+        packet.frame.release();
 
-                auto avgFrameTime = std::chrono::duration<std::double_t>{1.0 / fps};
-                auto time_to_sleep = needed_frame_time - avgFrameTime;
-                if(time_to_sleep.count() > 0){
-                    std::this_thread::sleep_for(time_to_sleep);
-#ifdef FMT
-//                    spdlog::trace("Sleeping for {} seconds", time_to_sleep);
-#endif
-                }
+        // Stop when the user has pressed "q", at the end of the input or of the requested range.
+        if((config.endFrame >= 0 && (std::int64_t)frameNumber >= config.endFrame)
+           || !OT::utils::hasFrame(*capture)){
+            return false;
+        }
+
+        if(!config.realtime || config.targetFps <= 0){
+            packet.frameNumber = ++frameNumber;
+            packet.dt = config.dt;
+            *capture >> packet.frame;
+            return !packet.frame.empty();
+        }
+
+        const std::chrono::duration<double> period{1. / config.targetFps};
+        auto now = clock::now();
+        if(!paceStarted){
+            paceStarted = true;
+            paceStart = now;
+            paceFirstFrame = frameNumber;
+            lastFrameTime = now - std::chrono::duration_cast<clock::duration>(period);
+        }
+
+        // Frame paceFirstFrame + n is due n periods after the first one. Frames whose
+        // deadline has passed are stale: drop them rather than fall further behind.
+        const auto due = paceFirstFrame + (std::uint64_t)((now - paceStart) / period);
+        while(frameNumber < due
+              && (config.endFrame < 0 || (std::int64_t)frameNumber + 1 < config.endFrame)
+              && capture->grab()){
+            frameNumber++;
+            droppedFrames++;
+        }
+
+        // Ahead of the deadline, wait for it.
+        const auto deadline = paceStart + std::chrono::duration_cast<clock::duration>(
+                period * (double)(frameNumber - paceFirstFrame));
+        if(now < deadline){
+            std::this_thread::sleep_until(deadline);
+        }
+
+        packet.frameNumber = ++frameNumber;
+        *capture >> packet.frame;
+
+        // config.dt is the time step of one frame period, scale it by the time that really passed.
+        now = clock::now();
+        packet.dt = config.dt * (float)((now - lastFrameTime) / period);
+        lastFrameTime = now;
+
+        return !packet.frame.empty();
+    }
+
+    void Tracker::logThroughput(std::uint64_t frames, std::chrono::duration<double> elapsed) const {
 #ifdef FMT
-                spdlog::debug("fps: {}", fps);
+        spdlog::info("Tracked {} frames, average fps: {}", frames, elapsed.count() > 0 ? frames / elapsed.count() : 0.);
+        if(droppedFrames > 0){
+            spdlog::info("Dropped {} frames to keep up with {} fps", droppedFrames, config.targetFps);
+        }
 #endif
+    }
+
+    namespace {
+        using FrameQueue = OT::utils::SpscQueue<FramePacket>;
+
+        // The pixel mapping cv::resize uses from an image of size `from` to one of size `to`.
+        cv::Mat resizeMatrix(cv::Size from, cv::Size to){
+            const double sx = (double)to.width / from.width;
+            const double sy = (double)to.height / from.height;
+            cv::Mat m = cv::Mat::eye(3, 3, CV_64F);
+            m.at<double>(0, 0) = sx;
+            m.at<double>(0, 2) = 0.5 * sx - 0.5;
+            m.at<double>(1, 1) = sy;
+            m.at<double>(1, 2) = 0.5 * sy - 0.5;
+            return m;
+        }
+
+        // Apply a homography to points given in integer pixels, for drawing.
+        std::vector<cv::Point> transformPoints(const std::vector<cv::Point>& points, const cv::Mat& homography){
+            std::vector<cv::Point2f> in(points.begin(), points.end()), out;
+            if (!in.empty()) {
+                cv::perspectiveTransform(in, out, homography);
             }
+            return {out.begin(), out.end()};
+        }
+
+        // Run `stage` on every packet of `in` and hand it on to `out`, until `in` is closed.
+        template<class Stage>
+        std::thread startStage(FrameQueue& in, FrameQueue* out, Stage stage){
+            return std::thread([&in, out, stage]() mutable {
+                FramePacket packet;
+                while(in.pop(packet)){
+                    stage(packet);
+                    if(out != nullptr){
+                        out->push(packet);
+                    }
+                }
+                if(out != nullptr){
+                    out->close();
+                }
+            });
         }
+    }
+
+    void Tracker::runPipelined() {
+        const auto depth = config.pipelineQueueDepth;
+        FrameQueue toPreprocess(depth), toDetect(depth), toTrack(depth), toEmit(depth);
+
+        // Every stage owns the state it touches, the queues keep the frames in order.
+        std::vector<std::thread> stages;
+        stages.push_back(startStage(toPreprocess, &toDetect, [this](FramePacket& packet){ preprocess(packet); }));
+        stages.push_back(startStage(toDetect, &toTrack, [this](FramePacket& packet){ detect(packet); }));
+        stages.push_back(startStage(toTrack, &toEmit, [this](FramePacket& packet){ associate(packet); }));
+        stages.push_back(startStage(toEmit, nullptr, [this](FramePacket& packet){ emit(packet); }));
+
+        auto start = std::chrono::steady_clock::now();
+        std::uint64_t frames = 0;
+
+        // Every packet pushed hands back one that went through the pipeline before, its
+        // buffers are filled again with the next frame.
+        FramePacket packet;
+        while(nextFrame(packet)) {
 #ifdef FMT
-        spdlog::info("average fps: {}", fps);
+            spdlog::trace("Got new image from stream");
 #endif
+            toPreprocess.push(packet);
+            frames++;
+        }
+
+        toPreprocess.close();
+        for(auto &stage: stages){
+            stage.join();
+        }
+
+        logThroughput(frames, std::chrono::steady_clock::now() - start);
     }
 
     std::string Tracker::track_frame(const cv::Mat& frame) {
+        FramePacket packet;
+        packet.frameNumber = ++frameNumber;
+        packet.dt = config.dt;
+        packet.frame = frame;
 
-        m_frame = frame;
-        frameNumber++;
+        preprocess(packet);
+        detect(packet);
+        associate(packet);
+        emit(packet);
+
+        std::stringstream ss;
+        trackerLog.logToStream(ss);
+        return ss.str();
+    }
 
+    void Tracker::preprocess(FramePacket& packet) {
+        auto &frame = packet.frame;
 
+#ifndef OT_HEADLESS
         if(show_windows){
-            std::cout<<std::endl<< m_frame<<std::endl;
+            std::cout<<std::endl<< frame<<std::endl;
 
-            cv::Mat tmp_frame = m_frame ;
+            cv::Mat tmp_frame = frame ;
 
-            m_frame.convertTo(tmp_frame, CV_8U, alpha);
+            frame.convertTo(tmp_frame, CV_8U, config.displayScale);
             cv::imshow("Original", tmp_frame);
         }
+#endif
 
-        // Do the perspective transform.
-        if (!points.empty()) {
-            cv::warpPerspective(m_frame, m_frame, perspectiveMatrix, perspectiveSize);
+        // Do the perspective transform and scale the image.
+        if (!warpScale.empty()) {
+            warpScale.apply(frame, frame);
+            return;
+        }
+
+        // In point space the frame is only scaled, detections are projected after the fact:
+        // undo the scaling, warp, then scale to the size the warped image would have had.
+        if (pointSpace) {
+            if (frame.size() != pointSourceSize) {
+                pointSourceSize = frame.size();
+                const auto scaled = OT::utils::scaledSize(pointSourceSize, maxDimension);
+                cv::Mat toWarped = cv::Mat(perspectiveMatrix * resizeMatrix(scaled, pointSourceSize));
+                pointHomography = cv::Mat(resizeMatrix(perspectiveSize, planeSize) * toWarped);
+            }
+            packet.homography = pointHomography;
         }
+        OT::utils::scale(frame, maxDimension);
+    }
+
+    void Tracker::projectDetections(FramePacket& packet) {
+        if (!packet.blobs.empty()) {
+            cv::perspectiveTransform(packet.blobs.centers, packet.blobs.centers, packet.homography);
+        }
+
+        // A projected rectangle is a quadrilateral, keep the box around it.
+        std::array<cv::Point2f, 4> corners;
+        for (auto &box : packet.blobs.boxes) {
+            corners[0] = cv::Point2f((float)box.x, (float)box.y);
+            corners[1] = cv::Point2f((float)(box.x + box.width), (float)box.y);
+            corners[2] = cv::Point2f((float)(box.x + box.width), (float)(box.y + box.height));
+            corners[3] = cv::Point2f((float)box.x, (float)(box.y + box.height));
+            cv::perspectiveTransform(corners, corners, packet.homography);
+            box = cv::boundingRect(corners);
+        }
+    }
 
-        // Scale the image.
-        OT::utils::scale(m_frame, maxDimension);
+    cv::Size Tracker::trackingSize(const FramePacket& packet) const {
+        return packet.homography.empty() ? packet.frame.size() : planeSize;
+    }
+
+    void Tracker::detect(FramePacket& packet) {
+        // Find the contours.
+        contourFinder.findContours(packet.frame, packet.blobs, config.foregroundThresh, config.foregroundMaxVal);
+
+#ifndef OT_HEADLESS
+        if(show_windows){
+            OT::utils::draw::contourShow("Contours", packet.blobs, packet.frame.size());
+        }
+#endif
+
+        if (!packet.homography.empty()) {
+            projectDetections(packet);
+        }
+    }
 
+    void Tracker::associate(FramePacket& packet) {
         // Create the tracker if it isn't created yet.
         if (tracker == nullptr) {
+            const auto size = trackingSize(packet);
             tracker = std::make_unique<OT::MultiObjectTracker>(
-                    cv::Size(m_frame.rows, m_frame.cols),
+                    cv::Size(size.height, size.width),
                     config.lifetimeThreshold,
                     config.distanceThreshold,
                     config.missedFramesThreshold,
@@ -254,28 +656,33 @@ namespace OT::tracking{
                     config.ageSuppressionThreshold);
         }
 
-        // Set the frame dimension.
-        trackerLog.setDimensions(m_frame.cols, m_frame.rows);
-
-        // Find the contours.
-        std::vector<cv::Point2f> mc(contours.size());
-        std::vector<cv::Rect> boundRect(contours.size());
-        contourFinder.findContours(m_frame, hierarchy, contours, mc, boundRect, config.foregroundThresh, config.foregroundMaxVal);
-
-        OT::utils::draw::contourShow("Contours", contours, boundRect, m_frame.size());
-
         // Update the predicted locations of the objects based on the observed
         // mass centers.
-        std::vector<OT::TrackingOutput> predictions;
-        tracker->update(mc, boundRect, predictions);
+        tracker->update(packet.blobs, packet.predictions, packet.dt);
+    }
+
+    void Tracker::emit(FramePacket& packet) {
+        auto &frame = packet.frame;
+
+        // Set the frame dimension.
+        const auto size = trackingSize(packet);
+        trackerLog.setDimensions(size.width, size.height);
+
+#ifndef OT_HEADLESS
+        // Tracks are on the warped plane, the preview shows the original frame.
+        cv::Mat toFrame;
+        if (show_windows && !packet.homography.empty()) {
+            toFrame = packet.homography.inv();
+        }
+#endif
 
         std::set<std::uint64_t> cur_objs;
 
         std::vector<TrackingDetectionEvent> new_events, events;
 
 
-        for (int i(0); i < predictions.size(); ++i) {
-            auto &pred = predictions[i];
+        for (int i(0); i < packet.predictions.size(); ++i) {
+            auto &pred = packet.predictions[i];
 
 
 
@@ -285,14 +692,23 @@ namespace OT::tracking{
             events.push_back({pred.id, pred.location });
             cur_objs.insert(pred.id);
 
-            // Draw a cross at the location of the prediction.
-            OT::utils::draw::drawCross(m_frame, pred.location, pred.color, 5);
-
-            // Draw the trajectory for the prediction.
-            OT::utils::draw::drawTrajectory(m_frame, pred.trajectory, pred.color);
+#ifndef OT_HEADLESS
+            if(show_windows){
+                if (toFrame.empty()) {
+                    // Draw a cross at the location of the prediction.
+                    OT::utils::draw::drawCross(frame, pred.location, pred.color, 5);
+
+                    // Draw the trajectory for the prediction.
+                    OT::utils::draw::drawTrajectory(frame, pred.trajectory, pred.color);
+                } else {
+                    OT::utils::draw::drawCross(frame, transformPoints({pred.location}, toFrame)[0], pred.color, 5);
+                    OT::utils::draw::drawTrajectory(frame, transformPoints(pred.trajectory, toFrame), pred.color);
+                }
+            }
+#endif
 
             // Update the tracker log.
-            trackerLog.addTrack(pred.id, pred.location.x, pred.location.y, (long)frameNumber);
+            trackerLog.addTrack(pred.id, pred.location.x, pred.location.y, (long)packet.frameNumber);
         }
 
         std::vector<std::uint64_t> res;
@@ -300,31 +716,28 @@ namespace OT::tracking{
         std::vector<EndTrackingEvent> end_events;
 
         for(const auto &item: res){
-            end_events.push_back({item, (std::uint64_t)(trackerLog.birthFrameForTrackerId[item]), frameNumber});
+            end_events.push_back({item, (std::uint64_t)(trackerLog.birthFrameForTrackerId[item]), packet.frameNumber});
         }
 
         for(const auto &cb: detection_callbacks) {
-            cb(frameNumber, new_events);
+            cb(packet.frameNumber, new_events);
         }
 
         for(const auto &cb: tracking_callbacks){
-            cb(frameNumber, new_events);
+            cb(packet.frameNumber, new_events);
         }
 
         for(const auto &cb: end_tracking_callbacks){
-            cb(frameNumber, end_events);
+            cb(packet.frameNumber, end_events);
         }
 
-
+#ifndef OT_HEADLESS
         if(show_windows){
-            cv::Mat tmp_frame = m_frame;
-            m_frame.convertTo(tmp_frame, CV_8U, alpha);
+            cv::Mat tmp_frame = frame;
+            frame.convertTo(tmp_frame, CV_8U, config.displayScale);
             cv::imshow("Video", tmp_frame);
         }
-
-        std::stringstream ss;
-        trackerLog.logToStream(ss);
-        return ss.str();
+#endif
     }
 
     void Tracker::add_detection_callback(const detection_callback &cb) {
@@ -347,44 +760,404 @@ namespace OT::tracking{
             return false;
         }
 
-        m_file = std::unique_ptr<std::FILE>(std::fopen(dir.string().c_str(), "rb"));
+        m_mapped.close();
+        m_file.reset();
+        m_index = nullptr;
+        m_offsets.clear();
+        m_pos = m_frameCount = 0;
+        m_released = 0;
+        already_grabbed = false;
+
+        m_rows = sensorSize.height;
+        m_cols = sensorSize.width;
+        m_format = sensorFormat;
+        m_frameBytes = (std::size_t)m_rows * m_cols * OT::io::bytesPerSample(m_format);
+        if(m_frameBytes == 0){
+            return false;
+        }
+
+        if(!(memoryMap && m_mapped.open(dir))){
+#ifdef FMT
+            if(memoryMap){
+                spdlog::warn("Can't map raw file \"{}\", falling back to buffered reads", dir.string());
+            }
+#endif
+            return openBuffered(dir);
+        }
+
+        if(OT::io::isRawContainer(m_mapped.data(), m_mapped.size())){
+            OT::io::RawContainerHeader header{};
+            if(!OT::io::parseRawContainer(m_mapped.data(), m_mapped.size(), header, m_index)){
+                m_mapped.close();
+                return false;
+            }
+            m_rows = (int)header.height;
+            m_cols = (int)header.width;
+            m_format = (OT::config::PixelFormat)header.pixelFormat;
+            m_frameBytes = OT::io::rawContainerFrameBytes(header);
+            m_frameCount = header.frameCount;
+        } else {
+            m_frameCount = m_mapped.size() / m_frameBytes;
+        }
+
+        if(m_frameCount > 0){
+            m_released = frameOffset(0);
+            m_mapped.willNeed(m_released, readAheadFrames * m_frameBytes);
+        }
+#ifdef FMT
+        spdlog::debug("Mapped raw file \"{}\" with {} frames of {}x{}", dir.string(), m_frameCount, m_cols, m_rows);
+#endif
         return true;
     }
 
-    bool RawFileCapture::grab() {
-        //std::cout << *capture << std::endl;
-        if(already_grabbed){
-            return true;
+    bool RawFileCapture::openBuffered(const fs::path &path) {
+        m_file.reset(std::fopen(path.string().c_str(), "rb"));
+        if(m_file == nullptr){
+            return false;
         }
 
-        auto buf = new std::int16_t[X_img * Y_img];
+        std::fseek(m_file.get(), 0, SEEK_END);
+        const auto size = (std::uint64_t)std::ftell(m_file.get());
+        std::fseek(m_file.get(), 0, SEEK_SET);
+        m_fileOffset = 0;
+
+        OT::io::RawContainerHeader header{};
+        if(std::fread(&header, sizeof(header), 1, m_file.get()) == 1
+           && OT::io::isRawContainer(reinterpret_cast<const std::uint8_t *>(&header), sizeof(header))){
+            if(header.version != OT::io::rawContainerVersion
+               || header.pixelFormat > (std::uint32_t)OT::config::PixelFormat::U8
+               || header.cvType != OT::io::rawCvType((OT::config::PixelFormat)header.pixelFormat)
+               || header.indexOffset > size
+               || header.frameCount > (size - header.indexOffset) / sizeof(std::uint64_t)){
+#ifdef FMT
+                spdlog::error("Invalid raw container \"{}\"", path.string());
+#endif
+                m_file.reset();
+                return false;
+            }
+
+            m_offsets.resize(header.frameCount);
+            std::fseek(m_file.get(), (long)header.indexOffset, SEEK_SET);
+            if(std::fread(m_offsets.data(), sizeof(std::uint64_t), m_offsets.size(), m_file.get()) != m_offsets.size()){
+                m_file.reset();
+                return false;
+            }
+            m_fileOffset = header.indexOffset + m_offsets.size() * sizeof(std::uint64_t);
 
-        fread(buf, sizeof(std::int16_t), (X_img * Y_img), m_file.get());
+            m_rows = (int)header.height;
+            m_cols = (int)header.width;
+            m_format = (OT::config::PixelFormat)header.pixelFormat;
+            m_frameBytes = OT::io::rawContainerFrameBytes(header);
+            m_frameCount = header.frameCount;
+        } else {
+            m_frameCount = size / m_frameBytes;
+            m_fileOffset = std::min<std::uint64_t>(size, sizeof(header));
+        }
+        return true;
+    }
 
-        const auto tmp_filepos = ftell(m_file.get());
+    std::uint64_t RawFileCapture::frameOffset(std::uint64_t index) const {
+        if(m_index != nullptr){
+            return OT::io::rawContainerOffset(m_index, index);
+        }
+        if(!m_offsets.empty()){
+            return m_offsets[index];
+        }
+        return index * m_frameBytes;
+    }
 
-        if(tmp_filepos == filepos || feof(m_file.get())){
-            delete[] buf;
+    bool RawFileCapture::grab() {
+        if(m_pos >= m_frameCount){
             return false;
         }
-        filepos = tmp_filepos;
 
-        cv::Mat frame(X_img, Y_img, CV_16SC1, buf);
-        //delete[] buf;
+        const auto offset = frameOffset(m_pos);
+
+        if(m_mapped.isOpen()){
+            // The samples are used straight from the mapping, nothing is copied
+            // unless they have to be converted.
+            m_raw = cv::Mat(m_rows, m_cols, OT::io::rawCvType(m_format), m_mapped.data() + offset);
+
+            // Everything before the frame just handed out won't be read again.
+            if(offset > m_released){
+                m_mapped.dontNeed(m_released, offset - m_released);
+            }
+            m_released = offset;
+            m_mapped.willNeed(offset + m_frameBytes, readAheadFrames * m_frameBytes);
+        } else {
+            if(m_file == nullptr){
+                return false;
+            }
+            if(offset != m_fileOffset){
+                std::fseek(m_file.get(), (long)offset, SEEK_SET);
+            }
+
+            // Reuses the buffer of the previous frame unless it was handed out.
+            OT::utils::detachIfShared(m_raw);
+            m_raw.create(m_rows, m_cols, OT::io::rawCvType(m_format));
+            if(std::fread(m_raw.data, m_frameBytes, 1, m_file.get()) != 1){
+                return false;
+            }
+            m_fileOffset = offset + m_frameBytes;
+        }
+
+        // Frames handed out earlier may still be in use further down a pipeline.
+        OT::utils::detachIfShared(cur_image);
+        OT::io::convertToWorking(m_format, m_raw, cur_image);
 
-        cur_image = frame;
+        // Counts shared with the mapping lose their pages on the next grab.
+        if(copyFrames && m_mapped.isOpen() && cur_image.data == m_raw.data){
+            auto &buffer = freeBuffer();
+            cur_image.copyTo(buffer);
+            cur_image = buffer;
+        }
 
-        //cur_image.convertTo(cur_image, CV_8U, alpha);
+        m_pos++;
         already_grabbed = true;
 
         return true;
     }
 
+    cv::Mat &RawFileCapture::freeBuffer() {
+        for(auto &buffer: m_pool){
+            // The stages drop their references with OpenCV's atomic decrement, so the count
+            // is read with an atomic add of 0, which also orders their last reads of the
+            // pixels before our write. At 1 only the pool holds the buffer, and only this
+            // thread hands out new references to it.
+            if(buffer.u != nullptr && CV_XADD(&buffer.u->refcount, 0) == 1){
+                return buffer;
+            }
+        }
+        m_pool.emplace_back();
+        return m_pool.back();
+    }
+
+    bool RawFileCapture::set(int propId, double value) {
+        if(propId != cv::CAP_PROP_POS_FRAMES || !isOpened() || value < 0 || value > (double)m_frameCount){
+            return false;
+        }
+
+        if(m_mapped.isOpen()){
+            // Give back the window around the old position. Frames still in use are copies
+            // when that matters, see copyFrames.
+            m_mapped.dontNeed(m_released, (readAheadFrames + 1) * m_frameBytes);
+        }
+
+        m_pos = (std::uint64_t)value;
+        already_grabbed = false;
+
+        if(m_mapped.isOpen() && m_pos < m_frameCount){
+            m_released = frameOffset(m_pos);
+            m_mapped.willNeed(m_released, readAheadFrames * m_frameBytes);
+        }
+        return true;
+    }
+
+    double RawFileCapture::get(int propId) const {
+        switch(propId){
+            case cv::CAP_PROP_POS_FRAMES:
+                // A grabbed frame that wasn't retrieved yet is still the current one.
+                return (double)(m_pos - (already_grabbed ? 1 : 0));
+            case cv::CAP_PROP_FRAME_COUNT:
+                return (double)m_frameCount;
+            case cv::CAP_PROP_FRAME_WIDTH:
+                return m_cols;
+            case cv::CAP_PROP_FRAME_HEIGHT:
+                return m_rows;
+            default:
+                return 0.;
+        }
+    }
+
     RawFileCapture &RawFileCapture::operator>>(cv::Mat &image) {
-        this->grab();
+        if(!already_grabbed){
+            this->grab();
+        }
         image = cur_image;
         already_grabbed = false;
         return *this;
     }
+    bool CompressedRawCapture::open(const cv::String &filename, int apiPreference, const std::vector<int> &params) {
+        prefetcher.reset();
+        m_chunk.clear();
+        m_chunkLoaded = false;
+        m_pos = 0;
+        already_grabbed = false;
+
+        auto path = fs::path{filename};
+        if(!fs::is_regular_file(path) || !m_mapped.open(path)){
+#ifdef FMT
+            spdlog::error("Can't map compressed recording \"{}\"", path.string());
+#endif
+            return false;
+        }
+
+        if(!OT::io::parseCompressedRaw(m_mapped.data(), m_mapped.size(), m_header, m_offsets)){
+            m_mapped.close();
+            return false;
+        }
+#ifdef FMT
+        spdlog::debug("Opened compressed recording \"{}\" with {} frames in {} chunks",
+                      path.string(), m_header.frameCount, m_header.chunkCount);
+#endif
+        return true;
+    }
+
+    std::vector<cv::Mat> CompressedRawCapture::loadChunk(std::size_t index) const {
+        const auto begin = OT::io::compressedChunkOffset(m_offsets, index);
+        const auto end = OT::io::compressedChunkOffset(m_offsets, index + 1);
+
+        std::vector<cv::Mat> frames;
+        if(!OT::io::decodeCompressedChunk(m_mapped.data() + begin, end - begin, m_header, frames)){
+#ifdef FMT
+            spdlog::error("Compressed chunk {} is corrupt", index);
+#endif
+            frames.clear();
+        }
+
+        const auto format = (OT::config::PixelFormat)m_header.pixelFormat;
+        for(auto &frame: frames){
+            cv::Mat working;
+            OT::io::convertToWorking(format, frame, working);
+            frame = working;
+        }
+        return frames;
+    }
+
+    bool CompressedRawCapture::seekChunk() {
+        const auto chunkIndex = m_pos / m_header.chunkFrames;
+        if(m_chunkLoaded && chunkIndex == m_chunkIndex){
+            return true;
+        }
+
+        // The compressed bytes of the chunk we leave won't be needed again. Decoded frames
+        // own their samples, so dropping the pages doesn't touch frames still in flight.
+        if(m_chunkLoaded){
+            const auto begin = OT::io::compressedChunkOffset(m_offsets, m_chunkIndex);
+            const auto end = OT::io::compressedChunkOffset(m_offsets, m_chunkIndex + 1);
+            m_mapped.dontNeed(begin, end - begin);
+        }
+
+        if(prefetchChunks == 0){
+            m_chunk = loadChunk(chunkIndex);
+        } else {
+            // Workers only follow sequential reads, jumping anywhere else restarts them.
+            if(prefetcher == nullptr || !m_chunkLoaded || chunkIndex != m_chunkIndex + 1){
+                prefetcher = std::make_unique<OT::utils::OrderedPrefetcher<std::vector<cv::Mat>>>(
+                        m_header.chunkCount,
+                        [this](std::size_t i){ return loadChunk(i); },
+                        prefetchChunks,
+                        decodeThreads,
+                        chunkIndex);
+            }
+            prefetcher->pop(m_chunk);
+        }
+
+        m_chunkIndex = chunkIndex;
+        m_chunkLoaded = true;
+        return m_pos % m_header.chunkFrames < m_chunk.size();
+    }
+
+    bool CompressedRawCapture::grab() {
+        if(!m_mapped.isOpen() || m_pos >= m_header.frameCount || !seekChunk()){
+            return false;
+        }
+
+        cur_image = m_chunk[m_pos % m_header.chunkFrames];
+        m_pos++;
+        already_grabbed = true;
+        return true;
+    }
+
+    CompressedRawCapture &CompressedRawCapture::operator>>(cv::Mat &image) {
+        if(!already_grabbed){
+            this->grab();
+        }
+        image = cur_image;
+        already_grabbed = false;
+        return *this;
+    }
+
+    bool CompressedRawCapture::set(int propId, double value) {
+        if(propId != cv::CAP_PROP_POS_FRAMES || !isOpened() || value < 0 || value > (double)m_header.frameCount){
+            return false;
+        }
+
+        m_pos = (std::uint64_t)value;
+        already_grabbed = false;
+        return true;
+    }
+
+    double CompressedRawCapture::get(int propId) const {
+        switch(propId){
+            case cv::CAP_PROP_POS_FRAMES:
+                return (double)(m_pos - (already_grabbed ? 1 : 0));
+            case cv::CAP_PROP_FRAME_COUNT:
+                return (double)m_header.frameCount;
+            case cv::CAP_PROP_FRAME_WIDTH:
+                return m_header.width;
+            case cv::CAP_PROP_FRAME_HEIGHT:
+                return m_header.height;
+            default:
+                return 0.;
+        }
+    }
+    bool StreamCapture::open(const cv::String &source, int apiPreference, const std::vector<int> &params) {
+        m_frames = 0;
+        already_grabbed = false;
+
+        if(!m_reader.open(source)){
+#ifdef FMT
+            spdlog::error("Can't open raw stream \"{}\"", source);
+#endif
+            return false;
+        }
+        return true;
+    }
+
+    bool StreamCapture::grab() {
+
+        auto &buffer = m_buffers[m_frames % m_buffers.size()];
+        OT::utils::detachIfShared(buffer);
+        buffer.create(frameSize, OT::io::rawCvType(format));
+
+        // The samples are read straight into the buffer.
+        if(!m_reader.readFully(buffer.data, buffer.total() * buffer.elemSize())){
+#ifdef FMT
+            spdlog::info("End of raw stream");
+#endif
+            m_reader.close();
+            return false;
+        }
+
+        OT::utils::detachIfShared(cur_image);
+        OT::io::convertToWorking(format, buffer, cur_image);
+
+        m_frames++;
+        already_grabbed = true;
+        return true;
+    }
+
+    StreamCapture &StreamCapture::operator>>(cv::Mat &image) {
+        if(!already_grabbed){
+            this->grab();
+        }
+        image = cur_image;
+        already_grabbed = false;
+        return *this;
+    }
+
+    double StreamCapture::get(int propId) const {
+        switch(propId){
+            case cv::CAP_PROP_POS_FRAMES:
+                return (double)(m_frames - (already_grabbed ? 1 : 0));
+            case cv::CAP_PROP_FRAME_WIDTH:
+                return frameSize.width;
+            case cv::CAP_PROP_FRAME_HEIGHT:
+                return frameSize.height;
+            default:
+                return 0.;
+        }
+    }
 } // OT
 
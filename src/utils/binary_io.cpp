@@ -0,0 +1,39 @@
+
+
+#include "utils/binary_io.h"
+
+namespace OT::utils {
+    bool writeMat(std::ostream& out, const cv::Mat& mat) {
+        if (mat.dims > 2) {
+            return false;
+        }
+        writeValue(out, (std::int32_t)mat.type());
+        writeValue(out, (std::int32_t)mat.rows);
+        writeValue(out, (std::int32_t)mat.cols);
+        const auto rowBytes = (std::streamsize)(mat.cols * mat.elemSize());
+        for (int y = 0; y < mat.rows; y++) {
+            out.write(reinterpret_cast<const char*>(mat.ptr(y)), rowBytes);
+        }
+        return (bool)out;
+    }
+
+    bool readMat(std::istream& in, cv::Mat& mat) {
+        std::int32_t type, rows, cols;
+        if (!readValue(in, type) || !readValue(in, rows) || !readValue(in, cols)) {
+            return false;
+        }
+        // Anything larger than a frame can be is corrupt, don't try to allocate it.
+        constexpr std::int32_t maxDimension = 1 << 15;
+        if (rows < 0 || rows > maxDimension || cols < 0 || cols > maxDimension
+            || type < 0 || type > CV_MAT_TYPE_MASK) {
+            return false;
+        }
+
+        mat.create(rows, cols, type);
+        const auto rowBytes = (std::streamsize)(mat.cols * mat.elemSize());
+        for (int y = 0; y < mat.rows; y++) {
+            in.read(reinterpret_cast<char*>(mat.ptr(y)), rowBytes);
+        }
+        return (bool)in;
+    }
+}
@@ -47,23 +47,21 @@ namespace OT::utils::draw {
         }
 
         void contourShow(const std::string& drawingName,
-                         const std::vector<std::vector<cv::Point>>& contours,
-                         const std::vector<cv::Rect>& boundingRect,
+                         const OT::BlobTable& blobs,
                          cv::Size imgSize) {
+#ifndef OT_HEADLESS
             cv::Mat drawing = cv::Mat::zeros(imgSize, CV_32FC3);
-            for (size_t i = 0; i < contours.size(); i++) {
-                cv::drawContours(drawing,
-                                 contours,
-                                 i,
-                                 cv::Scalar::all(127),
-                                 cv::FILLED,
-                                 8,
-                                 std::vector<cv::Vec4i>(),
-                                 0,
-                                 cv::Point());
-                OT::utils::draw::drawBoundingRect(drawing, boundingRect[i]);
+            for (size_t i = 0; i < blobs.size(); i++) {
+                // Fill the outline, as cv::drawContours does with cv::FILLED.
+                const cv::Point* outline = blobs.points.data() + blobs.outlineBegin[i];
+                const int outlineSize = blobs.outlineEnd[i] - blobs.outlineBegin[i];
+                if (outlineSize > 0) {
+                    cv::fillPoly(drawing, &outline, &outlineSize, 1, cv::Scalar::all(127), 8);
+                }
+                OT::utils::draw::drawBoundingRect(drawing, blobs.boxes[i]);
             }
             cv::imshow(drawingName, drawing);
+#endif
         }
     }
 
@@ -0,0 +1,71 @@
+
+
+#include "utils/frame_hash.h"
+
+#include <cstring>
+
+namespace OT::utils {
+    namespace {
+        constexpr std::uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+        constexpr std::uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+        constexpr std::uint64_t prime3 = 0x165667B19E3779F9ULL;
+
+        constexpr std::size_t lanes = 4;
+
+        std::uint64_t rotl(std::uint64_t x, int r) {
+            return (x << r) | (x >> (64 - r));
+        }
+
+        std::uint64_t round(std::uint64_t acc, std::uint64_t input) {
+            acc += input * prime2;
+            return rotl(acc, 31) * prime1;
+        }
+
+        std::uint64_t load64(const std::uint8_t *p) {
+            std::uint64_t v;
+            std::memcpy(&v, p, sizeof(v));
+            return v;
+        }
+
+        std::uint64_t avalanche(std::uint64_t h) {
+            h ^= h >> 33;
+            h *= prime2;
+            h ^= h >> 29;
+            h *= prime3;
+            h ^= h >> 32;
+            return h;
+        }
+
+        // Mix `size` bytes into the lanes. Whole groups of lanes * 8 bytes go through the
+        // lanes, the remaining bytes are returned in `tail`.
+        void mixRow(const std::uint8_t *data, std::size_t size, std::uint64_t (&acc)[lanes], std::uint64_t &tail) {
+            const std::size_t stride = lanes * sizeof(std::uint64_t);
+            std::size_t i = 0;
+            for (; i + stride <= size; i += stride) {
+                for (std::size_t l = 0; l < lanes; l++) {
+                    acc[l] = round(acc[l], load64(data + i + l * sizeof(std::uint64_t)));
+                }
+            }
+            for (; i < size; i++) {
+                tail = rotl(tail ^ (data[i] * prime3), 11) * prime1;
+            }
+        }
+    }
+
+    std::uint64_t frameHash(const cv::Mat &frame) {
+        std::uint64_t acc[lanes] = {prime1 + prime2, prime2, 0, 0 - prime1};
+        std::uint64_t tail = prime3;
+
+        // Rows are hashed one by one, so a view into a larger image hashes like a copy of it.
+        const auto rowBytes = (std::size_t)frame.cols * frame.elemSize();
+        for (int y = 0; y < frame.rows; y++) {
+            mixRow(frame.ptr<std::uint8_t>(y), rowBytes, acc, tail);
+        }
+
+        std::uint64_t h = rotl(acc[0], 1) + rotl(acc[1], 7) + rotl(acc[2], 12) + rotl(acc[3], 18);
+        h = round(h, tail);
+        h = round(h, ((std::uint64_t)frame.rows << 32) | (std::uint32_t)frame.cols);
+        h = round(h, (std::uint64_t)frame.type());
+        return avalanche(h);
+    }
+}
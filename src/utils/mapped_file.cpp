@@ -0,0 +1,100 @@
+
+
+#include "utils/mapped_file.h"
+
+#include <algorithm>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define OT_HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace OT::utils {
+#ifdef OT_HAVE_MMAP
+    namespace {
+        std::size_t pageSize() {
+            static const auto size = (std::size_t)sysconf(_SC_PAGESIZE);
+            return size;
+        }
+    }
+
+    MappedFile::~MappedFile() {
+        close();
+    }
+
+    bool MappedFile::open(const std::filesystem::path &path) {
+        close();
+
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+
+        struct stat st{};
+        if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+            ::close(fd);
+            return false;
+        }
+
+        // The mapping keeps its own reference to the file, so the descriptor can go right away.
+        void *addr = mmap(nullptr, (std::size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (addr == MAP_FAILED) {
+            return false;
+        }
+
+        m_data = static_cast<std::uint8_t *>(addr);
+        m_size = (std::size_t)st.st_size;
+        madvise(m_data, m_size, MADV_SEQUENTIAL);
+        return true;
+    }
+
+    void MappedFile::close() {
+        if (m_data != nullptr) {
+            munmap(m_data, m_size);
+        }
+        m_data = nullptr;
+        m_size = 0;
+    }
+
+    void MappedFile::willNeed(std::size_t offset, std::size_t length) const {
+        if (m_data == nullptr || offset >= m_size) {
+            return;
+        }
+        length = std::min(length, m_size - offset);
+
+        // Round outwards, reading a little more than asked is harmless.
+        std::size_t begin = offset / pageSize() * pageSize();
+        madvise(m_data + begin, offset + length - begin, MADV_WILLNEED);
+    }
+
+    void MappedFile::dontNeed(std::size_t offset, std::size_t length) const {
+        if (m_data == nullptr || offset >= m_size) {
+            return;
+        }
+        length = std::min(length, m_size - offset);
+
+        // Round inwards so that a page shared with a frame still in use is kept.
+        std::size_t begin = (offset + pageSize() - 1) / pageSize() * pageSize();
+        std::size_t end = (offset + length) / pageSize() * pageSize();
+        if (begin < end) {
+            madvise(m_data + begin, end - begin, MADV_DONTNEED);
+        }
+    }
+#else
+    MappedFile::~MappedFile() = default;
+
+    bool MappedFile::open(const std::filesystem::path &) {
+        return false;
+    }
+
+    void MappedFile::close() {}
+
+    void MappedFile::willNeed(std::size_t, std::size_t) const {}
+
+    void MappedFile::dontNeed(std::size_t, std::size_t) const {}
+#endif
+}
@@ -7,27 +7,45 @@
 
 namespace OT::utils {
 bool hasFrame(cv::VideoCapture& capture) {
+#ifdef OT_HEADLESS
+    // No windows, so no key presses to look for.
+    bool hasNotQuit = true;
+#else
     bool hasNotQuit = ((char) cv::waitKey(1)) != 'q';
+#endif
     bool hasAnotherFrame = capture.grab();
     return hasNotQuit && hasAnotherFrame;
 }
 
-void scale(cv::Mat& img, std::int64_t maxDimension) {
+cv::Size scaledSize(cv::Size size, std::int64_t maxDimension) {
     if (maxDimension == -1) {
-        return;
+        return size;
     }
-    if (maxDimension >= img.rows && maxDimension >= img.cols) {
-        return;
+    if (maxDimension >= size.height && maxDimension >= size.width) {
+        return size;
     }
 
-    std::double_t scale = (1.0 * (std::double_t)maxDimension) / img.rows;
-    if (img.cols > img.rows) {
-        scale = (1.0 * (std::double_t)maxDimension) / img.cols;
+    std::double_t scale = (1.0 * (std::double_t)maxDimension) / size.height;
+    if (size.width > size.height) {
+        scale = (1.0 * (std::double_t)maxDimension) / size.width;
     }
 
-    auto newRows = (std::int64_t)(img.rows * scale);
-    auto newCols = (std::int64_t)(img.cols * scale);
+    auto newRows = (std::int64_t)(size.height * scale);
+    auto newCols = (std::int64_t)(size.width * scale);
+    return {(int)newCols, (int)newRows};
+}
+
+void scale(cv::Mat& img, std::int64_t maxDimension) {
+    auto size = scaledSize(img.size(), maxDimension);
+    if (size == img.size()) {
+        return;
+    }
+    cv::resize(img, img, size);
+}
 
-    cv::resize(img, img, cv::Size2l(newCols, newRows));
+void detachIfShared(cv::Mat& buffer) {
+    if (buffer.u != nullptr && buffer.u->refcount > 1) {
+        buffer.release();
+    }
 }
 } // OT:utils
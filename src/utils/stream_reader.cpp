@@ -0,0 +1,96 @@
+
+
+#include "utils/stream_reader.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define OT_HAVE_POSIX_IO
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace OT::utils {
+#ifdef OT_HAVE_POSIX_IO
+    namespace {
+        const std::string unixPrefix = "unix:";
+
+        int connectUnixSocket(const std::string &path) {
+            sockaddr_un addr{};
+            if (path.size() >= sizeof(addr.sun_path)) {
+                return -1;
+            }
+            addr.sun_family = AF_UNIX;
+            std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+            int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (fd < 0) {
+                return -1;
+            }
+            if (connect(fd, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)) != 0) {
+                ::close(fd);
+                return -1;
+            }
+            return fd;
+        }
+    }
+
+    StreamReader::~StreamReader() {
+        close();
+    }
+
+    bool StreamReader::open(const std::string &source) {
+        close();
+
+        if (source == "-") {
+            m_fd = STDIN_FILENO;
+            m_owned = false;
+        } else if (source.compare(0, unixPrefix.size(), unixPrefix) == 0) {
+            m_fd = connectUnixSocket(source.substr(unixPrefix.size()));
+            m_owned = true;
+        } else {
+            m_fd = ::open(source.c_str(), O_RDONLY);
+            m_owned = true;
+        }
+        return m_fd >= 0;
+    }
+
+    void StreamReader::close() {
+        if (m_fd >= 0 && m_owned) {
+            ::close(m_fd);
+        }
+        m_fd = -1;
+        m_owned = false;
+    }
+
+    bool StreamReader::readFully(void *buffer, std::size_t size) {
+        auto *dst = static_cast<char *>(buffer);
+        while (size > 0 && m_fd >= 0) {
+            auto n = ::read(m_fd, dst, size);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            dst += n;
+            size -= (std::size_t)n;
+        }
+        return size == 0;
+    }
+#else
+    StreamReader::~StreamReader() = default;
+
+    bool StreamReader::open(const std::string &) {
+        return false;
+    }
+
+    void StreamReader::close() {}
+
+    bool StreamReader::readFully(void *, std::size_t) {
+        return false;
+    }
+#endif
+}
@@ -0,0 +1,45 @@
+
+
+#include "utils/warp_scale_map.h"
+#include "utils/misc.h"
+
+namespace OT::perspective {
+    WarpScaleMap::WarpScaleMap(const cv::Mat& perspective, cv::Size warpedSize, std::int64_t maxDimension)
+        : outputSize(OT::utils::scaledSize(warpedSize, maxDimension)) {
+        if (outputSize.area() <= 0) {
+            return;
+        }
+
+        // Output pixel -> warped pixel, the inverse of cv::resize's pixel center mapping.
+        const double sx = (double)warpedSize.width / outputSize.width;
+        const double sy = (double)warpedSize.height / outputSize.height;
+
+        // Warped pixel -> source pixel.
+        cv::Mat inverseMatrix = perspective.inv();
+        inverseMatrix.convertTo(inverseMatrix, CV_64F);
+        const auto *m = inverseMatrix.ptr<double>();
+
+        cv::Mat mapX(outputSize, CV_32FC1), mapY(outputSize, CV_32FC1);
+        for (int v = 0; v < outputSize.height; v++) {
+            auto *rowX = mapX.ptr<float>(v);
+            auto *rowY = mapY.ptr<float>(v);
+            const double wy = (v + 0.5) * sy - 0.5;
+            for (int u = 0; u < outputSize.width; u++) {
+                const double wx = (u + 0.5) * sx - 0.5;
+                const double w = m[6] * wx + m[7] * wy + m[8];
+                const double scale = w != 0 ? 1. / w : 0.;
+                rowX[u] = (float)((m[0] * wx + m[1] * wy + m[2]) * scale);
+                rowY[u] = (float)((m[3] * wx + m[4] * wy + m[5]) * scale);
+            }
+        }
+
+        // Fixed point maps are smaller and let remap skip the float to fixed conversion.
+        cv::convertMaps(mapX, mapY, mapXY, mapFraction, CV_16SC2);
+    }
+
+    void WarpScaleMap::apply(const cv::Mat& src, cv::Mat& dst) {
+        OT::utils::detachIfShared(buffer);
+        cv::remap(src, buffer, mapXY, mapFraction, cv::INTER_LINEAR, cv::BORDER_CONSTANT, cv::Scalar());
+        dst = buffer;
+    }
+}
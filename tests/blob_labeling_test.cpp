@@ -0,0 +1,84 @@
+
+
+#include "tracker/blob_labeling.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+
+#include <opencv2/opencv.hpp>
+
+namespace {
+    int failures = 0;
+
+    // A binary mask of speckle and short horizontal runs, with runs that cross word
+    // boundaries and reach the last column.
+    cv::Mat randomMask(std::mt19937& rng, int rows, int cols) {
+        cv::Mat mask(rows, cols, CV_8UC1);
+        const int density = (int)(rng() % 100);
+        for (int y = 0; y < rows; y++) {
+            auto* row = mask.ptr<std::uint8_t>(y);
+            for (int x = 0; x < cols; x++) {
+                row[x] = (int)(rng() % 100) < density ? 255 : 0;
+            }
+            if (rng() % 3 == 0) {
+                const int begin = (int)(rng() % cols);
+                const int end = std::min(cols, begin + 1 + (int)(rng() % 130));
+                std::fill(row + begin, row + end, 255);
+            }
+        }
+        return mask;
+    }
+
+    bool sameBlobs(const OT::BlobTable& a, const OT::BlobTable& b) {
+        return a.size() == b.size()
+               && std::equal(a.centers.begin(), a.centers.end(), b.centers.begin())
+               && std::equal(a.boxes.begin(), a.boxes.end(), b.boxes.begin())
+               && std::equal(a.areas.begin(), a.areas.end(), b.areas.begin());
+    }
+
+    bool sameLabels(const cv::Mat& a, const cv::Mat& b) {
+        for (int y = 0; y < a.rows; y++) {
+            if (!std::equal(a.ptr<int>(y), a.ptr<int>(y) + a.cols, b.ptr<int>(y))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Label random masks as bytes and bit-packed and compare the blobs and label images.
+     * The widths leave every kind of partial last word, and include a run ending in it.
+     */
+    void checkBitMaskLabeling() {
+        static constexpr int widths[] = {1, 2, 63, 64, 65, 127, 128, 129, 200};
+
+        std::mt19937 rng(54321);
+        OT::BlobLabeler labeler;
+        for (int cols : widths) {
+            for (int rows : {1, 2, 5, 40}) {
+                for (int repeat = 0; repeat < 20; repeat++) {
+                    const cv::Mat mask = randomMask(rng, rows, cols);
+                    OT::BitMask bits;
+                    bits.threshold(mask, 0);
+
+                    OT::BlobTable expected, actual;
+                    cv::Mat expectedLabels, actualLabels;
+                    labeler.label(mask, expected, &expectedLabels);
+                    labeler.label(bits, actual, &actualLabels);
+                    if (!sameBlobs(expected, actual) || !sameLabels(expectedLabels, actualLabels)) {
+                        failures++;
+                        std::cerr << "Labeling a " << rows << "x" << cols
+                                  << " BitMask differs from labeling its bytes" << std::endl;
+                    }
+                }
+            }
+        }
+    }
+}
+
+int main() {
+    checkBitMaskLabeling();
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
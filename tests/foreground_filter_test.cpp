@@ -0,0 +1,156 @@
+
+
+#include "tracker/foreground_filter.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+
+#include <opencv2/opencv.hpp>
+
+using OT::config::ForegroundFilterMethod;
+
+namespace {
+    int failures = 0;
+
+    // Speckle on both sides of the thresholds below, with a few solid blocks so that the
+    // median keeps something to dilate.
+    cv::Mat randomMask(std::mt19937& rng, int rows, int cols) {
+        static constexpr std::uint8_t values[] = {0, 60, 100, 101, 127, 200, 254, 255};
+        cv::Mat mask(rows, cols, CV_8UC1);
+        const int density = (int)(rng() % 100);
+        for (int y = 0; y < rows; y++) {
+            auto* row = mask.ptr<std::uint8_t>(y);
+            for (int x = 0; x < cols; x++) {
+                row[x] = (int)(rng() % 100) < density ? values[rng() % 8] : 0;
+            }
+        }
+        for (int blocks = (int)(rng() % 4); blocks > 0; blocks--) {
+            const int top = (int)(rng() % rows);
+            const int left = (int)(rng() % cols);
+            const int bottom = std::min(rows, top + 1 + (int)(rng() % 12));
+            const int right = std::min(cols, left + 1 + (int)(rng() % 12));
+            for (int y = top; y < bottom; y++) {
+                std::fill(mask.ptr<std::uint8_t>(y) + left, mask.ptr<std::uint8_t>(y) + right, 255);
+            }
+        }
+        return mask;
+    }
+
+    bool sameMask(const cv::Mat& a, const cv::Mat& b) {
+        if (a.rows != b.rows || a.cols != b.cols) {
+            return false;
+        }
+        for (int y = 0; y < a.rows; y++) {
+            if (!std::equal(a.ptr<std::uint8_t>(y), a.ptr<std::uint8_t>(y) + a.cols, b.ptr<std::uint8_t>(y))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void expectSameMask(const cv::Mat& expected, const cv::Mat& actual, const std::string& what) {
+        if (!sameMask(expected, actual)) {
+            failures++;
+            std::cerr << what << std::endl;
+        }
+    }
+
+    /**
+     * Filter random masks with `method` and with REFERENCE and compare the results. The
+     * sizes cover widths that aren't a multiple of 64 and masks shorter than the median
+     * window, the dilations go up to a radius larger than the mask, and the thresholds
+     * include those that set every pixel or none. The bits method is also checked with a
+     * bit-packed result, which is what the CCL backend labels.
+     */
+    void checkMethod(ForegroundFilterMethod method, const char* name) {
+        const cv::Size sizes[] = {{1, 1}, {65, 1}, {64, 3}, {63, 4}, {130, 8}, {7, 33}, {200, 70}};
+        static constexpr int medianSizes[] = {3, 5, 9};
+        static constexpr double thresholds[] = {-1., 0., 100.5, 254., 255., 300.};
+
+        std::mt19937 rng(12345);
+        for (const auto size : sizes) {
+            const int dilations[] = {0, 1, 2, 3, 8, size.width + size.height};
+            for (int medianSize : medianSizes) {
+                for (int dilateIterations : dilations) {
+                    for (int stripes : {1, 4}) {
+                        for (double thresh : thresholds) {
+                            const cv::Mat mask = randomMask(rng, size.height, size.width);
+
+                            OT::ForegroundFilter reference(medianSize, dilateIterations,
+                                                           ForegroundFilterMethod::REFERENCE);
+                            OT::ForegroundFilter filter(medianSize, dilateIterations, method);
+                            filter.stripes = stripes;
+
+                            std::ostringstream what;
+                            what << name << " differs from REFERENCE for a " << size.height << "x"
+                                 << size.width << " mask, median " << medianSize << ", " << dilateIterations
+                                 << " dilations, " << stripes << " stripes, threshold " << thresh;
+
+                            cv::Mat expected, actual;
+                            reference.apply(mask, expected, thresh, 255.);
+                            filter.apply(mask, actual, thresh, 255.);
+                            expectSameMask(expected, actual, what.str());
+
+                            if (method == ForegroundFilterMethod::BITS) {
+                                OT::BitMask bits;
+                                filter.apply(mask, bits, thresh, 255.);
+                                bits.toMat(actual, 255);
+                                expectSameMask(expected, actual, what.str() + ", packed");
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * With a median of 1 the bits method only dilates. Compare it with cv::dilate for every
+     * radius up to 8, on masks shorter than the window of the rows that are ORed and with
+     * stripes whose edges fall on every row of short masks.
+     */
+    void checkBitDilation() {
+        static constexpr int heights[] = {1, 2, 3, 5, 9, 16, 17, 18, 40};
+        static constexpr int widths[] = {1, 63, 64, 65, 150};
+
+        std::mt19937 rng(999);
+        for (int rows : heights) {
+            for (int cols : widths) {
+                for (int radius = 0; radius <= 8; radius++) {
+                    for (int stripes : {1, 2, 3, 7}) {
+                        // Sparse points, so that the dilated squares stay apart.
+                        cv::Mat mask(rows, cols, CV_8UC1);
+                        for (int y = 0; y < rows; y++) {
+                            auto* row = mask.ptr<std::uint8_t>(y);
+                            for (int x = 0; x < cols; x++) {
+                                row[x] = rng() % 40 == 0 ? 255 : 0;
+                            }
+                        }
+
+                        cv::Mat expected, actual;
+                        cv::dilate(mask, expected, cv::Mat(), cv::Point(-1, -1), radius);
+                        OT::ForegroundFilter filter(1, radius, ForegroundFilterMethod::BITS);
+                        filter.stripes = stripes;
+                        filter.apply(mask, actual, 0., 255.);
+
+                        std::ostringstream what;
+                        what << "BITS differs from cv::dilate for a " << rows << "x" << cols << " mask, radius "
+                             << radius << ", " << stripes << " stripes";
+                        expectSameMask(expected, actual, what.str());
+                    }
+                }
+            }
+        }
+    }
+}
+
+int main() {
+    checkMethod(ForegroundFilterMethod::FUSED, "FUSED");
+    checkMethod(ForegroundFilterMethod::BITS, "BITS");
+    checkBitDilation();
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
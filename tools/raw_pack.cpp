@@ -0,0 +1,119 @@
+
+#include "io/compressed_raw.h"
+#include "io/pixel_format.h"
+#include "io/raw_container.h"
+
+#include "lyra/help.hpp"
+#include "lyra/lyra.hpp"
+#include "lyra/opt.hpp"
+
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+
+namespace fs = std::filesystem;
+
+// Feed every frame of the headerless input to the writer.
+template <class Writer>
+int pack(std::FILE *input, Writer &writer, const cv::Mat &buffer,
+         const fs::path &outputPath) {
+  cv::Mat frame = buffer;
+  const auto frameBytes = frame.total() * frame.elemSize();
+  while (std::fread(frame.data, frameBytes, 1, input) == 1) {
+    if (!writer.write(frame)) {
+      std::cerr << "Failed to write frame " << writer.frameCount() << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  const auto frames = writer.frameCount();
+  if (!writer.close()) {
+    std::cerr << "Failed to finish " << outputPath << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "Packed " << frames << " frames into " << outputPath
+            << std::endl;
+  return EXIT_SUCCESS;
+}
+
+// Convert a headerless raw recording into an indexed raw container or, with
+// --compress, into a losslessly compressed recording. The samples are kept as
+// they are, only their geometry and format are recorded.
+int main(int argc, char *argv[]) {
+  bool showHelp = false;
+
+  fs::path inputPath;
+  fs::path outputPath;
+  int width = 384;
+  int height = 288;
+  std::string format = "s16";
+  bool compress = false;
+  std::uint32_t chunkFrames = 32;
+
+  auto cli =
+      lyra::help(showHelp) |
+      lyra::opt(inputPath, "inputPath")["-i"]["--input"]("headerless raw file")
+          .required() |
+      lyra::opt(outputPath, "outputPath")["-o"]["--output"]("indexed container")
+          .required() |
+      lyra::opt(width, "width")["--width"]("frame width") |
+      lyra::opt(height, "height")["--height"]("frame height") |
+      lyra::opt(format, "format")["--format"]("s16, u16, u14 or u8") |
+      lyra::opt(compress)["-z"]["--compress"]("write a compressed recording") |
+      lyra::opt(chunkFrames, "chunkFrames")["--chunk"](
+          "frames per independently decodable chunk");
+
+  auto result = cli.parse({argc, argv});
+  if (!result) {
+    std::cerr << "Error in command line: " << result.message() << std::endl;
+    std::cout << cli << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if (showHelp) {
+    std::cout << cli << std::endl;
+    return EXIT_SUCCESS;
+  }
+
+  static const std::map<std::string, OT::config::PixelFormat> formats = {
+      {"s16", OT::config::PixelFormat::S16},
+      {"u16", OT::config::PixelFormat::U16},
+      {"u14", OT::config::PixelFormat::U14},
+      {"u8", OT::config::PixelFormat::U8},
+  };
+  const auto it = formats.find(format);
+  if (it == formats.cend() || width <= 0 || height <= 0) {
+    std::cerr << "Invalid frame geometry or format" << std::endl;
+    return EXIT_FAILURE;
+  }
+  const auto pixelFormat = it->second;
+
+  std::unique_ptr<std::FILE, decltype(&std::fclose)> input(
+      std::fopen(inputPath.string().c_str(), "rb"), &std::fclose);
+  if (input == nullptr) {
+    std::cerr << "Can't open " << inputPath << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  cv::Mat frame(height, width, OT::io::rawCvType(pixelFormat));
+
+  if (compress) {
+    OT::io::CompressedRawWriter writer;
+    if (!writer.open(outputPath, width, height, pixelFormat, chunkFrames)) {
+      std::cerr << "Can't create " << outputPath << std::endl;
+      return EXIT_FAILURE;
+    }
+    return pack(input.get(), writer, frame, outputPath);
+  }
+
+  OT::io::RawContainerWriter writer;
+  if (!writer.open(outputPath, width, height, pixelFormat)) {
+    std::cerr << "Can't create " << outputPath << std::endl;
+    return EXIT_FAILURE;
+  }
+  return pack(input.get(), writer, frame, outputPath);
+}